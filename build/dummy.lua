@@ -0,0 +1,5 @@
+
+assert_true(1, "1 is True")
+assert_eq(1, 1, "1 = 1")
+assert_ge(1, 2, "1 >= 2")
+assert_gt(2, 1)
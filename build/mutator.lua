@@ -0,0 +1,323 @@
+
+local _ = {}
+
+--[[
+    TYPES OF ARGS
+    -------------
+    combination of flags
+    in/out pointer to struct
+    string:path
+    string:arbitrary
+    file descr
+    pid
+    address
+    byte count
+--]]
+
+--[[ lua types (as returned by type(x):
+    "nil", "number", "string", "boolean",
+    "table", "function", "thread", "userdata"
+]]
+
+----------------------------------------------------
+
+_.TypeChoice = {
+    --set = {}
+}
+
+function _.TypeChoice:new(values)
+    -- TODO: see same for Flags
+    tbl = { set = {} }
+    for i,v in ipairs(values) do
+        tbl.set[i] = v
+    end
+    setmetatable(tbl, self)
+    self.__index = self
+    return tbl
+end
+
+function _.TypeChoice:random()
+    local n = #(self.set)
+    if n < 1 then return nil end
+    return self.set[math.random(1,n)]
+end
+
+-- function :for_each
+
+----------------------------------------------------
+
+_.TypeInteger = {
+    min = math.mininteger,
+    max = math.maxinteger
+}
+
+function _.TypeInteger:new(tbl)
+    tbl = tbl or {}
+    setmetatable(tbl, self)
+    self.__index = self
+    return tbl 
+end
+
+function _.TypeInteger:random()
+    return math.random(self.min, self.max)
+end
+
+----------------------------------------------------
+
+_.TypeFlags = {
+    --set = {}
+}
+
+-- values: flags to combine, any number up to 64;
+-- weights: optional probability of each flag (default 0.5)
+function _.TypeFlags:new(vals, weights)
+    tbl = {set = {}}
+    for i,v in ipairs(vals) do
+        tbl.set[i] = v
+    end
+    tbl.flags = flagset(tbl.set, weights)
+    setmetatable(tbl, self)
+    self.__index = self
+    return tbl
+end
+
+function _.TypeFlags:random()
+    return self.flags:random()
+end
+
+-- f(value) for every combination, one flag changes per call
+function _.TypeFlags:for_each(f)
+    for v in self.flags:subsets() do
+        f(v)
+    end
+end
+
+----------------------------------------------------
+
+local sys = require "syscalls"
+local pid = syscall(sys.getpid)
+
+-- Scratch objects handed out as fd/path/buffer arguments.
+-- Only things the mutator owns: no std streams, no /dev nodes
+-- (fchmod on them as root would outlive the run).
+local scratch = "mutator." .. pid
+syscall(sys.mkdir, scratch, S_IRWXU)
+syscall(sys.mkdir, scratch .. "/dir", S_IRWXU)
+
+local paths = {
+    scratch, scratch .. "/dir", scratch .. "/file", scratch .. "/link",
+    scratch .. "/none/x", "", "/proc/self/status"
+}
+
+-- buffers live in the first 80k of a 1M arena: a kernel write past
+-- a buffer (counts are not tied to sizes) still lands in the arena
+local BUFSIZE = 4096
+local mem = arena(1 << 20)
+local fill = mem:buffer(BUFSIZE)
+for i = 0, BUFSIZE - 1, 4 do
+    fill:write(string.pack("<I4", math.random(0, 0xffffffff)), i)
+end
+
+local fds = {}
+local function pool_fd(fd) if fd >= 0 then fds[#fds + 1] = fd end end
+pool_fd(syscall(sys.open, scratch .. "/file",
+    O_CREAT | O_RDWR | O_NONBLOCK, S_IRUSR | S_IWUSR))
+pool_fd(syscall(sys.open, scratch .. "/dir", O_RDONLY))
+pool_fd(syscall(sys.open, "/proc/self/status", O_RDONLY))
+local pipefd = mem:buffer(8)
+if 0 == syscall(sys.pipe2, pipefd, O_NONBLOCK) then
+    local r, w = string.unpack("<i4i4", pipefd:str())
+    pool_fd(r)
+    pool_fd(w)
+end
+local maxfd = math.max(table.unpack(fds))
+-- file status flags of the pool, put back after calls that set them:
+-- a pipe that lost O_NONBLOCK blocks the next read or splice forever
+local fd_flags = {}
+for i = 1, #fds do
+    fd_flags[fds[i]] = syscall(sys.fcntl, fds[i], F_GETFL)
+end
+fds[#fds + 1] = AT_FDCWD
+fds[#fds + 1] = -1
+fds[#fds + 1] = 1023
+
+_.TypeBuffer = {}
+
+-- one buffer per kind and argument position, shared by all syscalls
+local buffers = {}
+
+-- kind = "buf": random bytes, "obuf"/"ptr": zeroed before each use
+function _.TypeBuffer:new(kind, pos)
+    local key = kind .. pos
+    buffers[key] = buffers[key] or mem:buffer(BUFSIZE, 64)
+    tbl = { buf = buffers[key], kind = kind }
+    setmetatable(tbl, self)
+    self.__index = self
+    return tbl
+end
+
+function _.TypeBuffer:random()
+    if "ptr" == self.kind and math.random(1, 8) == 1 then return 0 end
+    if "buf" == self.kind then
+        self.buf:write(fill:str(math.random(0, BUFSIZE - 1)))
+    else
+        self.buf:fill(0)
+    end
+    return self.buf
+end
+
+local ints = {0, 1, -1, 2, 3, 4, 8, 16, 64, 255, 256, 4096,
+    0x7fffffff, -0x80000000}
+
+-- unknown flags: any of the low 32 bits, a few at a time
+local bits, bit_weights = {}, {}
+for i = 0, 31 do
+    bits[#bits + 1] = 1 << i
+    bit_weights[#bit_weights + 1] = 0.08
+end
+
+-- argument generators per prototype kind (syscall_info(nr).args);
+-- called with the argument position, return a Type* object
+_.kinds = {
+    int = function() return _.TypeChoice:new(ints) end,
+    uint = function() return _.TypeInteger:new{min = 0, max = 1024} end,
+    fd = function() return _.TypeChoice:new(fds) end,
+    path = function() return _.TypeChoice:new(paths) end,
+    str = function() return _.TypeChoice:new{"", "lktk", scratch,
+        string.rep("A", 300)} end,
+    buf = function(pos) return _.TypeBuffer:new("buf", pos) end,
+    obuf = function(pos) return _.TypeBuffer:new("obuf", pos) end,
+    ptr = function(pos) return _.TypeBuffer:new("ptr", pos) end,
+    len = function() return _.TypeChoice:new{0, 1, 8, 64, 512,
+        BUFSIZE - 1, BUFSIZE} end,
+    flags = function() return _.TypeFlags:new(bits, bit_weights) end,
+    mode = function() return _.TypeChoice:new{0, 0x1a4, 0x1ed, 0x1ff,
+        0xfff} end,
+    pid = function() return _.TypeChoice:new{pid, 0} end,
+    uid = function() return _.TypeChoice:new{0, 65534, -1} end,
+    gid = function() return _.TypeChoice:new{0, 65534, -1} end,
+    sig = function() return _.TypeInteger:new{min = 0, max = 64} end,
+    addr = function() return _.TypeChoice:new{0, fill:addr()} end,
+    off = function() return _.TypeChoice:new{0, 1, 512, 4096, -1,
+        1 << 40} end,
+    cmd = function() return _.TypeInteger:new{min = 0, max = 64} end,
+}
+
+-- flag sets for syscalls where the generic bits are too far off
+local open_flags = {O_WRONLY, O_RDWR, O_CREAT, O_TRUNC, O_APPEND, O_EXCL,
+    O_NONBLOCK, O_CLOEXEC, O_SYNC, O_DSYNC, O_NOCTTY}
+_.flags = {
+    open = open_flags,
+    openat = open_flags,
+}
+
+-- Never forwarded: calls that would kill, block, or unmap the
+-- fuzzer itself, or change the machine for the following tests.
+_.denied = {}
+for n in string.gmatch([[
+    exit exit_group fork vfork clone clone3 execve execveat
+    kill tkill tgkill rt_sigqueueinfo rt_tgsigqueueinfo pidfd_send_signal
+    rt_sigaction rt_sigprocmask rt_sigreturn sigaltstack alarm setitimer
+    timer_create
+    pause nanosleep clock_nanosleep wait4 waitid futex futex_waitv
+    poll ppoll select pselect6 epoll_wait epoll_pwait epoll_pwait2
+    rt_sigsuspend rt_sigtimedwait msgrcv msgsnd semop semtimedop
+    io_getevents io_pgetevents mq_timedreceive mq_timedsend
+    mmap munmap mremap mprotect pkey_mprotect madvise process_madvise
+    brk shmat shmdt remap_file_pages process_vm_writev rseq mlockall
+    close close_range dup2 dup3 chdir fchdir chroot pivot_root
+    mount umount2 move_mount swapon swapoff reboot kexec_load
+    kexec_file_load init_module finit_module delete_module
+    ptrace seccomp prctl arch_prctl personality set_tid_address
+    set_robust_list set_thread_area modify_ldt iopl ioperm vhangup
+    setuid setgid setreuid setregid setresuid setresgid setfsuid
+    setfsgid setgroups capset unshare setns landlock_restrict_self
+    setrlimit prlimit64 sched_setaffinity sched_setscheduler
+    sched_setparam sched_setattr syslog acct sethostname setdomainname
+    settimeofday clock_settime clock_adjtime adjtimex umask
+    msgctl semctl shmctl
+]], "%S+") do
+    _.denied[n] = true
+end
+
+-- these leave new fds behind: everything above the pool is closed
+-- after them, or the fd table would fill up
+local creates_fd = {}
+for n in string.gmatch([[
+    open openat openat2 creat dup fcntl pipe pipe2 socket socketpair
+    accept accept4 eventfd
+    eventfd2 epoll_create epoll_create1 signalfd signalfd4
+    timerfd_create inotify_init inotify_init1 memfd_create memfd_secret
+    userfaultfd pidfd_open pidfd_getfd fanotify_init perf_event_open
+    open_by_handle_at fsopen fsmount fspick open_tree io_uring_setup
+    landlock_create_ruleset mq_open bpf
+]], "%S+") do
+    creates_fd[n] = true
+end
+
+-- fcntl(F_SETFL) and ioctl(FIONBIO) change the pool's status flags
+local sets_flags = { fcntl = true, ioctl = true }
+
+-- syscall nr -> {name = , [1..n] = Type*}, built on first use
+local syscall_prototypes = {}
+
+function _.prototype(n)
+    local proto = syscall_prototypes[n]
+    if proto then return proto end
+    local info = syscall_info(n)
+    proto = { name = info and info.name or tostring(n) }
+    local args = info and info.args
+    if not args then -- unknown: six plain ints
+        args = {"int", "int", "int", "int", "int", "int"}
+    end
+    for i, kind in ipairs(args) do
+        if "flags" == kind and _.flags[proto.name] then
+            proto[i] = _.TypeFlags:new(_.flags[proto.name])
+        else
+            proto[i] = _.kinds[kind](i)
+        end
+    end
+    syscall_prototypes[n] = proto
+    return proto
+end
+
+-- generated arguments for syscall n
+function _.args(n)
+    local proto = _.prototype(n)
+    local args = { n = #proto }
+    for i = 1, #proto do
+        args[i] = proto[i]:random()
+    end
+    return args
+end
+
+-- remove the scratch directory (fds stay open until exit);
+-- fuzzed *at() calls leave names anywhere below it
+function _.cleanup()
+    os.execute("chmod -R u+rwx " .. scratch .. " ; rm -rf " .. scratch)
+end
+
+-- Overload syscall with random args
+-- while module is been loaded
+local globalsyscall = syscall
+_.syscall = globalsyscall
+syscall = function(n)
+    local proto = _.prototype(n)
+    if _.denied[proto.name] then
+        return -1, EPERM
+    end
+    local args = _.args(n)
+    local res, err = globalsyscall(n, table.unpack(args, 1, args.n))
+    if creates_fd[proto.name] and res >= 0 then
+        if 0 ~= globalsyscall(sys.close_range, maxfd + 1, -1, 0)
+                and res > maxfd then
+            globalsyscall(sys.close, res)
+        end
+    end
+    if sets_flags[proto.name] and fd_flags[args[1]] then
+        globalsyscall(sys.fcntl, args[1], F_SETFL, fd_flags[args[1]])
+    end
+    return res, err
+end
+
+return _
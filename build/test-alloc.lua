@@ -0,0 +1,45 @@
+-- Lua state allocator: size class slabs and their statistics
+local st = alloc.stats()
+for _, k in ipairs{"allocs", "frees", "reallocs", "large", "bytes", "peak",
+        "slabs", "slab_bytes"} do
+    assert_true(math.type(st[k]) == "integer", "stats." .. k)
+end
+assert_true(st.slabs > 0 and st.slab_bytes >= st.slabs * 4096, "slabs")
+assert_true(st.peak >= st.bytes, "peak")
+assert_true(math.abs(st.bytes - collectgarbage("count") * 1024) < 4096,
+    "bytes agree with the collector")
+
+-- the same kind of churn again reuses the blocks freed by the first
+local function churn()
+    for i = 1, 20000 do
+        local t = {__type = "flock", l_type = i, l_start = i}
+        t.name = "f" .. (i % 64)
+    end
+end
+churn()
+collectgarbage()
+local before = alloc.stats()
+churn()
+collectgarbage()
+local after = alloc.stats()
+assert_true(after.allocs - before.allocs >= 20000, "allocs counted")
+assert_true(after.frees - before.frees >= 20000, "frees counted")
+assert_true(after.slabs <= before.slabs + 1, "freed blocks reused")
+local small = 0
+for size, n in pairs(after.classes) do
+    assert_true(size % 16 == 0 and size <= 512 and n > 0, "class " .. size)
+    small = small + 1
+end
+assert_true(small > 0, "classes")
+
+-- big blocks go elsewhere, resizing across classes keeps contents
+alloc.reset()
+local s = string.rep("x", 100000)
+st = alloc.stats()
+assert_true(st.large >= 1, "large")
+assert_true(st.allocs < 100, "reset counts from 0")
+assert_true(st.peak >= 100000, "reset peak")
+local t = {}
+for i = 1, 1000 do t[i] = i end
+for i = 1, 1000 do assert_eq(t[i], i, "grown table") end
+assert_eq(#s, 100000, "large string")
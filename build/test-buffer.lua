@@ -0,0 +1,45 @@
+local sys = require "syscalls"
+
+local a = arena(1 << 20)
+assert_true(a ~= nil, "arena mapped")
+assert_eq(#a, 1 << 20, "arena size")
+
+local wbuf = a:buffer(4096, 4096)
+local rbuf = a:buffer(4096, 4096)
+assert_eq(wbuf:addr() % 4096, 0, "page aligned buffer")
+assert_eq(#wbuf, 4096, "buffer length")
+
+local pid = syscall(sys.getpid)
+local filename = "buffer." .. pid
+local fd = syscall(sys.open, filename,
+    O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)
+assert_gt(fd, 0, "file created")
+
+wbuf:fill(0x41)
+wbuf:write("head")
+assert_eq(syscall(sys.write, fd, wbuf, #wbuf), 4096, "write from buffer")
+
+-- read back into a writable buffer, then a slice of it
+rbuf:fill(0)
+assert_eq(syscall(sys.pread64, fd, rbuf, #rbuf, 0), 4096, "pread into buffer")
+assert_true(rbuf:str(0, 4) == "head", "contents read back")
+assert_true(rbuf:str(4096 - 2) == "AA", "tail read back")
+local tail = rbuf:slice(4000, 96)
+tail:fill(0)
+assert_eq(syscall(sys.pread64, fd, tail, #tail, 0), 96, "pread into slice")
+assert_true(rbuf:str(4000, 4) == "head", "slice aliases its buffer")
+
+-- buffers as pointer fields of structs
+local iov = struct(iovec, {iov_base = rbuf:slice(0, 16), iov_len = 16})
+rbuf:fill(0)
+assert_eq(syscall(sys.preadv, fd, iov, 1, 0), 16, "preadv into buffer")
+assert_true(rbuf:str(0, 4) == "head", "preadv contents")
+
+-- no room: nil, ENOMEM; reset reuses the arena
+local big, err = a:buffer(2 << 20)
+assert_true(big == nil and err == 12, "arena exhausted")
+a:reset()
+assert_eq(a:avail(), 1 << 20, "arena reset")
+
+syscall(sys.close, fd)
+syscall(sys.unlink, filename)
@@ -0,0 +1,61 @@
+local sys = require "syscalls"
+require "utils"
+
+-- collector policies and counters
+local st = gc.stats()
+assert_eq(st.policy, "inc", "default policy")
+for _, k in ipairs{"ns", "steps", "full"} do
+    assert_true(math.type(st[k]) == "integer" and st[k] >= 0, "stats." .. k)
+end
+
+local function churn(n)
+    for i = 1, n do
+        local t = {__type = "flock", l_type = i, name = "f" .. i}
+    end
+end
+
+-- iteration: nothing runs while the job does
+gc.policy("iteration")
+assert_eq(gc.stats().policy, "iteration", "policy set")
+assert_true(not collectgarbage("isrunning"), "collector stopped")
+st = gc.stats()
+churn(100000)
+assert_eq(gc.stats().steps, st.steps, "no steps during the job")
+
+-- step: fixed work after each syscall
+gc.policy("step", 2)
+assert_true(not collectgarbage("isrunning"), "no automatic steps")
+st = gc.stats()
+for i = 1, 200 do syscall(sys.getpid) end
+assert_eq(gc.stats().steps, st.steps + 400, "steps per syscall")
+
+-- incremental, with pacing
+gc.policy("inc", 100, 400)
+assert_true(collectgarbage("isrunning"), "collector running")
+st = gc.stats()
+churn(100000)
+local now = gc.stats()
+assert_true(now.steps > st.steps and now.ns > st.ns, "steps are timed")
+collectgarbage()
+assert_eq(gc.stats().full, now.full + 1, "full cycles counted")
+
+assert_true(not pcall(gc.policy, "generational"), "unknown policy")
+assert_true(not pcall(gc.policy, "step", 0), "budget checked")
+
+-- -G sets the policy of every job, the job may change its own
+local script = "gc." .. syscall(sys.getpid) .. ".lua"
+local out = io.open(script, "w")
+out:write('print(gc.stats().policy, collectgarbage("isrunning"))\n',
+    'gc.policy("inc")\n')
+out:close()
+local function run(opts)
+    return shell("./lktk " .. opts .. " " .. script)
+end
+assert_true(run("-q -G iteration -c 2"):find("^iteration\tfalse\niteration\tfalse\n"),
+    "-G iteration")
+assert_true(run("-q -G step:3"):find("^step\tfalse"), "-G step")
+assert_true(run("-q -G inc:150:300"):find("^inc\ttrue"), "-G inc")
+assert_true(run("-v -G iteration"):find("GC: [%d.]+ ms in %d+ steps, %d+ full"),
+    "GC time reported per job")
+assert_true(run("-q -G bogus"):find("usage"), "bad policy")
+syscall(sys.unlink, script)
@@ -0,0 +1,84 @@
+local sys = require "syscalls"
+require "utils"
+
+-- a failed job leaves a trace, -r replays it
+local pid = syscall(sys.getpid)
+local dir = "record." .. pid
+local script = "record." .. pid .. ".lua"
+syscall(sys.mkdir, dir, 448)
+
+local function traces()
+    local t = {}
+    for f in shell("ls " .. dir):gmatch("%S+%.trace") do
+        t[#t + 1] = dir .. "/" .. f
+    end
+    return t
+end
+local function job(body)
+    local out = io.open(script, "w")
+    out:write('local sys = require "syscalls"\n', body)
+    out:close()
+    return shell("./lktk -q -R " .. dir .. " " .. script)
+end
+
+job('syscall(sys.getpid)\nsyscall(sys.access, "/", 0)\n')
+assert_eq(#traces(), 0, "clean job leaves no trace")
+
+local s = job('syscall(sys.getpid)\nsyscall(sys.access, "/", 0)\n'
+    .. 'syscall(sys.access, "/nonexistent", 0)\nassert_true(false, "fail")\n')
+local t = traces()
+assert_eq(#t, 1, "failed job leaves a trace")
+assert_true(s:find(t[1], 1, true), "trace reported")
+
+s = shell("./lktk -v -r " .. t[1])
+assert_true(s:find("replay: " .. script, 1, true), "replay header")
+assert_true(s:find("access(#", 1, true), "verbose replay lists calls")
+-- only getpid answers otherwise in another process
+assert_true(s:find("replay: 3 calls, 1 with other results", 1, true),
+    "calls replay with the recorded results")
+os.remove(t[1])
+
+-- batches, fuzzer programs and uring submissions are recorded too
+s = job('syscall_batch({{sys.getuid}, {sys.access, "/", 0}}, 2)\n'
+    .. 'fuzzer{calls = {sys.getuid}, seed = 1}:run(3)\n'
+    .. 'local ring = uring(4)\nring:prep(URING_NOP)\nring:submit(1)\n'
+    .. 'ring:close()\nassert_true(false, "fail")\n')
+t = traces()
+assert_eq(#t, 1, "failed job leaves a trace")
+s = shell("./lktk -v -r " .. t[1])
+local calls = s:match("replay: (%d+) calls, 0 with other results")
+-- 2 rounds of 2 batched calls, 3 programs of at least one call
+assert_true(calls and tonumber(calls) >= 7, "batch and fuzzer calls replay")
+assert_true(s:find("1 uring submissions listed only", 1, true),
+    "uring submission recorded")
+assert_true(s:find("sqe op 0 ", 1, true), "with its SQEs")
+
+os.remove(t[1])
+
+-- fds created by replayed calls stand in for the recorded ones
+local out = dir .. "/out"
+s = job('local fd = syscall(sys.open, "' .. out .. '", O_CREAT | O_WRONLY, 384)\n'
+    .. 'syscall(sys.write, fd, "hello", 5)\nsyscall(sys.close, fd)\n'
+    .. 'print("fd " .. fd)\nassert_true(false, "fail")\n')
+local fd = tonumber(s:match("fd (%d+)"))
+t = traces()
+assert_eq(#t, 1, "failed job leaves a trace")
+os.remove(out)
+-- keep the recorded fd number taken, so replay's open gets another one
+local busy = ""
+for i = 3, fd do busy = busy .. " " .. i .. "</dev/null" end
+s = shell("./lktk -r " .. t[1] .. busy)
+assert_true(s:find("replay: 3 calls, 0 with other results", 1, true),
+    "open, write and close replay on the new fd")
+local f = io.open(out)
+assert_true(f and f:read("a") == "hello", "replayed write reached the file")
+if f then f:close() end
+
+local junk = io.open(dir .. "/junk", "w")
+junk:write(string.rep("x", 4096))
+junk:close()
+assert_true(shell("./lktk -r " .. dir .. "/junk"):find("not a trace", 1, true),
+    "replay checks the magic")
+
+syscall(sys.unlink, script)
+os.execute("rm -rf " .. dir)
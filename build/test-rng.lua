@@ -0,0 +1,80 @@
+local sys = require "syscalls"
+require "utils"
+
+-- same seed, same job: same numbers, whatever process runs it
+local script = "rng." .. syscall(sys.getpid) .. ".lua"
+local out = io.open(script, "w")
+out:write('print(rng.seed(), math.random(1, 1 << 40), rng.stream(3):random(1000))')
+out:close()
+local function run(opts)
+    return shell("./lktk -q " .. opts .. " " .. script)
+end
+assert_true(run("-S 7") == run("-S 7"), "-S replays a run")
+assert_true(run("-S 7") ~= run("-S 8"), "seeds differ")
+assert_true(run("-S 7"):match("^7%s"), "seed reported")
+local two = run("-S 7 -c 2")
+local a, b = two:match("^(.-\n)(.-\n)$")
+assert_true(a and a ~= b, "iterations get their own streams")
+syscall(sys.unlink, script)
+
+-- forked children: a stream each, not a copy of their sibling's
+local drawn = {}
+for i = 1, 2 do
+    local name = "rng." .. syscall(sys.getpid) .. "." .. i
+    if 0 == fork() then
+        local f = io.open(name, "w")
+        f:write(rng.bytes(16))
+        f:close()
+        syscall(sys.exit_group, 0)
+    end
+    wait()
+    local f = io.open(name, "r")
+    drawn[i] = f:read("a")
+    f:close()
+    syscall(sys.unlink, name)
+end
+assert_eq(#drawn[1], 16, "child drew")
+assert_true(drawn[1] ~= drawn[2], "siblings get their own streams")
+
+-- math.random keeps its interface
+for i = 1, 200 do
+    local v = math.random(-3, 3)
+    assert_true(v >= -3 and v <= 3 and math.type(v) == "integer",
+        "random in interval")
+end
+local x = math.random()
+assert_true(x >= 0 and x < 1, "float in [0, 1)")
+assert_true(math.random(math.mininteger, math.maxinteger) ~= nil,
+    "full integer range")
+assert_true(not pcall(math.random, 2, 1), "empty interval")
+
+math.randomseed(42)
+local s1 = {math.random(1000), math.random(1000), math.random(1000)}
+math.randomseed(42)
+local s2 = {math.random(1000), math.random(1000), math.random(1000)}
+assert_true(s1[1] == s2[1] and s1[2] == s2[2] and s1[3] == s2[3],
+    "randomseed restarts the stream")
+assert_true(pcall(math.randomseed, os.clock() + 0.5), "float seed")
+math.randomseed(0.5)
+local f = math.random(1 << 30)
+math.randomseed(1.5)
+assert_true(f ~= math.random(1 << 30), "float seeds differ by their bits")
+
+-- streams: independent of each other and of the job stream
+local r1, r2 = rng.stream(1), rng.stream(1)
+math.random()
+assert_eq(r1:random(1 << 30), r2:random(1 << 30), "same id, same stream")
+assert_true(rng.stream(1):bytes(16) ~= rng.stream(2):bytes(16),
+    "other id, other stream")
+
+-- bulk generation
+assert_eq(#rng.bytes(100000), 100000, "bytes")
+local a = arena(1 << 16)
+local buf = a:buffer(4096)
+buf:fill(0)
+rng.fill(buf, 8, 16)
+assert_true(buf:str(0, 8) == string.rep("\0", 8), "fill keeps offset")
+assert_true(buf:str(8, 16) ~= string.rep("\0", 16), "fill writes")
+assert_true(buf:str(24, 8) == string.rep("\0", 8), "fill keeps length")
+r1:fill(buf)
+assert_true(not pcall(rng.fill, buf, 4000, 200), "fill stays in buffer")
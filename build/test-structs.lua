@@ -0,0 +1,78 @@
+local sys = require "syscalls"
+
+-- output only struct with string fields
+local uts = {__type = new_utsname}
+assert_eq(syscall(sys.uname, uts), 0, "uname")
+assert_true(uts.sysname == "Linux", "sysname is Linux")
+assert_true(#uts.release > 0, "release is set")
+
+-- nested members are flattened: st_mtim.tv_sec -> st_mtime_sec
+local st = {__type = stat}
+assert_eq(syscall(sys.stat, "/", st), 0, "stat")
+assert_gt(st.st_mtime_sec, 0, "mtime seconds")
+assert_eq(st.st_mode & S_IFMT, S_IFDIR, "'/' is a directory")
+
+local ts = {__type = timespec}
+assert_eq(syscall(sys.clock_gettime, 1, ts), 0, "clock_gettime")
+assert_ge(ts.tv_nsec, 0, "tv_nsec")
+assert_gt(1000000000, ts.tv_nsec, "tv_nsec below 1s")
+
+local rl = {__type = rlimit}
+assert_eq(syscall(sys.getrlimit, 7, rl), 0, "getrlimit(RLIMIT_NOFILE)")
+assert_gt(rl.rlim_cur, 0, "open files limit")
+
+-- input structs: pointer field taking a Lua string
+local fd = syscall(sys.open, "/dev/null", O_WRONLY)
+assert_gt(fd, 0, "open /dev/null")
+local msg = "struct payload"
+local iov = {__type = iovec, iov_base = msg, iov_len = #msg}
+assert_eq(syscall(sys.writev, fd, iov, 1), #msg, "writev")
+
+-- 16 bit fields both ways
+local pfd = {__type = pollfd, fd = fd, events = 4, revents = -1}
+assert_eq(syscall(sys.poll, pfd, 1, 0), 1, "poll")
+assert_eq(pfd.revents, 4, "POLLOUT on /dev/null")
+
+syscall(sys.close, fd)
+
+-- file_handle has room for the largest handle the kernel writes
+local fh = struct(file_handle, {handle_bytes = 128})
+assert_ge(#fh, 136, "file_handle payload included")
+local mount_id = arena(4096):buffer(8)
+if 0 == syscall(sys.name_to_handle_at, AT_FDCWD, ".", fh, mount_id, 0) then
+    assert_gt(fh.handle_bytes, 0, "handle written")
+    assert_ge(128, fh.handle_bytes, "handle within MAX_HANDLE_SZ")
+end
+
+-- struct objects: fields live in C memory, no copies per call
+local sto = struct(stat)
+assert_eq(syscall(sys.stat, "/", sto), 0, "stat into struct object")
+assert_eq(sto.st_ino, st.st_ino, "same inode as table version")
+assert_eq(#sto, #struct(stat), "#object is struct size")
+
+local lck = struct(flock, {l_type = F_WRLCK, l_whence = 0})
+lck.l_len = -1
+assert_eq(lck.l_type, F_WRLCK, "field set by constructor")
+assert_eq(lck.l_len, -1, "signed field read back")
+assert_true(not pcall(function() lck.no_such_field = 1 end),
+    "unknown field raises an error")
+
+local sa = struct(sched_attr)
+assert_eq(sa.size, #sa, "size field defaults to struct size")
+assert_eq(syscall(sys.sched_getattr, 0, sa, #sa, 0), 0, "sched_getattr")
+
+local iov2 = struct(iovec, {iov_base = msg, iov_len = #msg})
+fd = syscall(sys.open, "/dev/null", O_WRONLY)
+assert_eq(syscall(sys.writev, fd, iov2, 1), #msg, "writev with struct object")
+syscall(sys.close, fd)
+
+-- argument tables with metatables: fields through __index, results
+-- through __newindex
+local seen = {}
+fd = syscall(sys.open, "/dev/null", O_WRONLY)
+local proxy = setmetatable({__type = pollfd, fd = fd}, {
+    __index = {events = 4},
+    __newindex = function(t, k, v) seen[k] = v end})
+assert_eq(syscall(sys.poll, proxy, 1, 0), 1, "poll, events from __index")
+assert_eq(seen.revents, 4, "revents through __newindex")
+syscall(sys.close, fd)
@@ -0,0 +1,23 @@
+local sys = require "syscalls"
+
+assert_eq(syscall_info("getpid").nr, sys.getpid, "native table matches info")
+assert_true(sys[ARCH] == nil, "arch is not a syscall")
+assert_true(getmetatable(sys) == ARCH, "table tagged with its arch")
+assert_true(not pcall(function() sys.getpid = 1 end), "table is read-only")
+
+local n = 0
+for name, nr in pairs(sys) do
+    assert_true(syscall_info(nr).name == name, "number maps back to " .. name)
+    n = n + 1
+end
+assert_gt(n, 300, "table populated")
+
+local info = syscall_info(sys.read)
+assert_eq(info.nargs, 3, "read takes three arguments")
+assert_true(info.args[1] == "fd" and info.args[2] == "obuf"
+    and info.args[3] == "len", "read prototype")
+
+-- foreign tables are available for cross-arch traces
+assert_eq(require("syscalls.arm64").getpid, 172, "arm64 getpid")
+assert_eq(require("syscalls.i386").getpid, 20, "i386 getpid")
+assert_eq(syscall_info(172, "arm64").name, "getpid", "lookup by arch")
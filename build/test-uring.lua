@@ -0,0 +1,78 @@
+local sys = require "syscalls"
+
+local ring, err = uring(64)
+if not ring then
+    print("io_uring not available, errno "..err)
+    return
+end
+
+local name = "uring."..syscall(sys.getpid)
+local msg = "Hello io_uring!\n"
+
+-- openat
+ring:prep(URING_OPENAT, AT_FDCWD, name, S_IRWXU,
+    0, O_CREAT | O_RDWR)
+ring:submit(1)
+local tags, res = ring:reap(1)
+assert_eq(#res, 1, "one completion")
+local fd = res[1]
+assert_gt(fd, 0, "file opened via io_uring")
+
+-- many writes in flight at once
+local n = 32
+for i = 0,n-1 do
+    ring:prep(URING_WRITE, fd, msg, #msg, i * #msg)
+end
+assert_eq(ring:pending(), n, "writes in flight")
+ring:submit()
+local done, total = 0, 0
+while done < n do
+    tags, res = ring:reap(1)
+    for i = 1,#res do
+        total = total + res[i]
+    end
+    done = done + #res
+end
+assert_eq(total, n * #msg, "bytes written")
+
+-- completions are not ordered: match them by tag
+local tag = ring:prep(URING_FSYNC, fd)
+ring:submit(1)
+tags, res = ring:reap(1)
+assert_eq(tags[1], tag, "fsync completion")
+assert_eq(res[1], 0, "fsync")
+ring:prep(URING_CLOSE, fd)
+ring:submit(1)
+tags, res = ring:reap(1)
+assert_eq(res[1], 0, "close")
+
+local st = {__type = stat}
+syscall(sys.stat, name, st)
+assert_eq(st.st_size, n * #msg, "file size")
+syscall(sys.unlink, name)
+ring:close()
+assert_true(not pcall(ring.pending, ring), "closed ring refuses requests")
+
+-- close drops what is only prepared and waits for what is submitted
+ring = uring(8)
+for i = 1, 4 do
+    ring:prep(URING_NOP)
+end
+ring:submit()
+ring:prep(URING_NOP)
+assert_eq(ring:pending(), 5, "requests left in flight")
+ring:close()
+
+-- a read that never completes is cancelled, not waited for
+local pipefd = arena(4096):buffer(8)
+assert_eq(syscall(sys.pipe2, pipefd, 0), 0, "pipe")
+local rfd, wfd = string.unpack("<i4i4", pipefd:str())
+local buf = arena(4096):buffer(16)
+ring = uring(8)
+ring:prep(URING_READ, rfd, buf, #buf, 0)
+ring:submit()
+local t0 = os.time()
+ring:close()
+assert_true(os.time() - t0 < 2, "pending read cancelled on close")
+syscall(sys.close, rfd)
+syscall(sys.close, wfd)
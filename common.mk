@@ -1,6 +1,34 @@
 
 CC = gcc
-CFLAGS = -Wall -Wextra -g -O0 -DDEBUG=1
+
+# BUILD=debug (default) or BUILD=release
+# PGO=gen builds instrumented binary, PGO=use builds with collected profile
+# VMDISPATCH=switch (default) or VMDISPATCH=goto for the threaded Lua VM
+BUILD ?= debug
+PGO ?=
+VMDISPATCH ?= switch
+
+ifeq ($(BUILD),release)
+  OPTFLAGS = -O2 -flto -DNDEBUG -DDEBUG=0
+  LDOPTFLAGS = -O2 -flto
+else
+  OPTFLAGS = -g -O0 -DDEBUG=1
+  LDOPTFLAGS =
+endif
+
+ifeq ($(PGO),gen)
+  OPTFLAGS += -fprofile-generate -fprofile-update=atomic
+  LDOPTFLAGS += -fprofile-generate
+endif
+ifeq ($(PGO),use)
+  OPTFLAGS += -fprofile-use -fprofile-correction -Wno-missing-profile
+  LDOPTFLAGS += -fprofile-use
+endif
+ifeq ($(VMDISPATCH),goto)
+  OPTFLAGS += -DLUA_USE_JUMPTABLE=1
+endif
+
+CFLAGS = -Wall -Wextra $(OPTFLAGS)
 
 INSTALLDIR = build
 KERNTEST = $(PWD)/kit/lktk
@@ -1293,6 +1293,33 @@ int grep_kernel_messages(int level, struct timeval *after, int verbose) {
 	return ctl.count;
 }
 
+/*
+ * Parses one /dev/kmsg record as returned by a single read()
+ * (NUL terminated), for callers that keep their own kmsg fd open
+ * and only want to look at new records.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int parse_kmsg_line(char *buf, size_t sz, struct kmsg_line *line)
+{
+	static struct dmesg_control ctl;
+	struct dmesg_record rec;
+	const char *seq;
+
+	if (parse_kmsg_record(&ctl, &rec, buf, sz) != 0)
+		return -1;
+
+	seq = strchr(buf, ',');
+	line->seq = seq ? strtoull(seq + 1, NULL, 10) : 0;
+	line->level = rec.level;
+	line->facility = rec.facility;
+	line->flags = rec.flags;
+	line->tv = rec.tv;
+	line->mesg = rec.mesg;
+	line->mesg_size = rec.mesg_size;
+	return 0;
+}
+
 #if DOEXE
 int main(int argc, char *argv[]) {
 	// show all messages
@@ -1,4 +1,18 @@
 #ifndef DMESG_H
 #define DMESG_H
+#include <stddef.h>
+#include <sys/time.h>
+
+struct kmsg_line {
+	unsigned long long seq;
+	int level;
+	int facility;
+	char flags;
+	struct timeval tv;
+	const char *mesg;
+	size_t mesg_size;
+};
+
 int grep_kernel_messages(int level, struct timeval *after, int verbose);
+int parse_kmsg_line(char *buf, size_t sz, struct kmsg_line *line);
 #endif
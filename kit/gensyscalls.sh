@@ -0,0 +1,48 @@
+#!/bin/sh
+# Generates syscall number tables syscalls_<arch>.h (LKTK_NR(name, nr)
+# lines) from the kernel UAPI headers installed for the compiler.
+# Usage: gensyscalls.sh "<cc>" [outdir]
+# A foreign arch whose headers are missing gets an empty table; an
+# empty table for the arch the compiler targets is an error.
+
+CC=${1:-gcc}
+OUT=${2:-.}
+
+# the arch lktksyscalls.c picks as native
+NATIVE=$(printf '%s\n' '#if defined(__x86_64__)' x86_64 \
+    '#elif defined(__i386__)' i386 '#elif defined(__aarch64__)' arm64 \
+    '#endif' | $CC -E -P - | tr -d ' \n')
+
+# arch, header, extra cpp flags
+gen() {
+    if [ "$1" = "$NATIVE" ]; then ERR=/dev/stderr; else ERR=/dev/null; fi
+    printf '#include <%s>\n' "$2" | $CC -E -dM $3 - 2>$ERR | awk '
+        $1 == "#define" && $2 ~ /^__NR(3264)?_/ { def[$2] = $3 }
+        END {
+            for (d in def) {
+                if (d !~ /^__NR_/ || d == "__NR_syscalls") continue
+                v = def[d]
+                if (v in def) v = def[v] # __NR_fcntl -> __NR3264_fcntl
+                if (v !~ /^[0-9]+$/) continue
+                printf "LKTK_NR(%s, %d)\n", substr(d, 6), v
+            }
+        }' | sort -t, -k2 -n > "$OUT/syscalls_$1.h.tmp"
+    if [ "$1" = "$NATIVE" ] && [ ! -s "$OUT/syscalls_$1.h.tmp" ]; then
+        echo "gensyscalls.sh: no syscall numbers in <$2> for $1" >&2
+        rm -f "$OUT/syscalls_$1.h.tmp"
+        exit 1
+    fi
+    {
+        echo "/* generated by gensyscalls.sh from <$2>, do not edit */"
+        cat "$OUT/syscalls_$1.h.tmp"
+    } > "$OUT/syscalls_$1.h"
+    rm -f "$OUT/syscalls_$1.h.tmp"
+}
+
+gen x86_64 asm/unistd_64.h
+gen i386 asm/unistd_32.h
+# arch/arm64/include/uapi/asm/unistd.h
+gen arm64 asm-generic/unistd.h "-D__BITS_PER_LONG=64 \
+    -D__ARCH_WANT_RENAMEAT -D__ARCH_WANT_NEW_STAT \
+    -D__ARCH_WANT_SET_GET_RLIMIT -D__ARCH_WANT_TIME32_SYSCALLS \
+    -D__ARCH_WANT_SYS_CLONE3 -D__ARCH_WANT_MEMFD_SECRET"
@@ -5,6 +5,7 @@
  */
 
 #define lua_c
+#define _GNU_SOURCE /* syscall, wait4 */
 
 #include "lprefix.h"
 #include <signal.h>
@@ -17,8 +18,27 @@
 
 #include "lktklib.h"
 #include "lktkassert.h"
+#include "lktkuring.h"
+#include "lktkkmsg.h"
+#include "lktklog.h"
+#include "lktkstruct.h"
+#include "lktkbuf.h"
+#include "lktksyscalls.h"
+#include "lktkfuzz.h"
+#include "lktkflags.h"
+#include "lktkrand.h"
+#include "lktkrec.h"
+#include "lktkalloc.h"
+#include "lktkgc.h"
 
 #include <getopt.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <stdint.h>
 
 #if !defined(LUA_PROMPT)
 #define LUA_PROMPT      "#> "
@@ -90,6 +110,8 @@ static const char *progname = LUA_PROGNAME;
 
 //TODO: multiple libraries ; avoid global
 static const char *libname;
+static const char *replay_file; /* -r */
+static int fresh_jobs; /* -F */
 /********************************************/
 
 static inline int is_bit_set(const int bit, const unsigned int mask) {
@@ -125,18 +147,27 @@ static const char* kern_taint_msg[TAINT_FLAGS_COUNT] = {
     "Kernel has been live patched"
 };
 
+/* kept open for the whole run, re-read with pread */
+static int tainted_fd = -1;
+
 unsigned int get_tainted(void) {
     char buffer[16];
-    int tainted_fd = open(tainted_file, O_RDONLY);
-    // todo: throw
-    buffer[15] = 0;
-    //lseek(taint_fd, 0, SEEK_SET);
-    read(tainted_fd, buffer, 10);
-    return (unsigned int)atoi(buffer);
+    ssize_t n;
+    if (tainted_fd < 0) {
+        tainted_fd = open(tainted_file, O_RDONLY | O_CLOEXEC);
+        if (tainted_fd < 0) {
+            return 0;
+        }
+    }
+    n = pread(tainted_fd, buffer, sizeof(buffer) - 1, 0);
+    if (n <= 0) {
+        return 0;
+    }
+    buffer[n] = 0;
+    return (unsigned int)strtoul(buffer, NULL, 10);
 }
 
-void print_tainted(void) {
-    int mask = get_tainted();
+void print_tainted(unsigned int mask) {
     if (!mask) {
         echo_good("Kernel not tainted");
         return;
@@ -150,10 +181,67 @@ void print_tainted(void) {
     }
 }
 
-// actually only new errors are of interest
-// but there is no way to clear bits
+/*
+ * Taint bits cannot be cleared, so new errors are told apart
+ * by snapshots: one for the whole run, one before each script.
+ */
+static struct {
+    unsigned int at_start;  /* whole run */
+    unsigned int before;    /* current script */
+    unsigned int fresh;     /* set while current script was running */
+    unsigned kmsg_before;
+    unsigned kmsg_fresh;
+    char first[128];        /* first script which tainted the kernel */
+} taint;
+
+static void taint_start(void) {
+    taint.at_start = get_tainted();
+    if (taint.at_start & TAINT_ERROR) {
+        echo_warn("Kernel is already tainted: %x", taint.at_start);
+    }
+}
+
+static void taint_begin(void) {
+    taint.before = get_tainted();
+    taint.kmsg_before = kmsg_watch_errors();
+}
+
+/* remembers first script to set new bits */
+static void taint_blame(unsigned int fresh, const char *script, int iteration) {
+    if (fresh && !taint.first[0]) {
+        snprintf(taint.first, sizeof(taint.first), "%s #%d (%x)",
+                script, iteration, fresh);
+    }
+}
+
+static unsigned int taint_end(const char *script, int iteration) {
+    taint.fresh = get_tainted() & ~taint.before;
+    taint.kmsg_fresh = kmsg_watch_errors() - taint.kmsg_before;
+    if (taint.fresh) {
+        echo_error("%s #%d tainted the kernel: %x",
+                script, iteration, taint.fresh);
+        taint_blame(taint.fresh, script, iteration);
+    }
+    return taint.fresh;
+}
+
+static void taint_stop(void) {
+    unsigned int fresh = get_tainted() & ~taint.at_start;
+    if (taint.first[0]) {
+        echo_error("Kernel first tainted by %s", taint.first);
+    }
+    if (fresh && kit.verbose) {
+        print_tainted(fresh);
+    }
+    if (tainted_fd >= 0) {
+        close(tainted_fd);
+        tainted_fd = -1;
+    }
+}
+
+// only errors which appeared during last script
 int did_kernel_error(void) {
-    return (0 != (get_tainted() & TAINT_ERROR));
+    return (0 != (taint.fresh & TAINT_ERROR)) || (taint.kmsg_fresh > 0);
 }
 
 /************** status ********************************/
@@ -162,15 +250,21 @@ void print_status(lua_State *L) {
     int failures = kit.failures;
     if (failures) {
         echo_error("Assertions failed: %d", failures);
+        echo_info("seed: %llu", kit.seed);
     } else {
         echo_good("Assertions succeed");
     }
     if (did_kernel_error()) {
         echo_error("There were kernel errors!");
-        print_tainted();
+        if (!failures) {
+            echo_info("seed: %llu", kit.seed);
+        }
+        print_tainted(taint.fresh);
     } else {
         echo_good("No new kernel errors");
     }
+    echo_info("GC: %.3f ms in %llu steps, %llu full", lktk_gc_last.ns / 1e6,
+            lktk_gc_last.steps, lktk_gc_last.full);
 }
 
 /************** tainted ends **************************/
@@ -466,20 +560,207 @@ static int pushargs(lua_State *L) {
     return n;
 }
 
-static int handle_script(lua_State *L, char **argv) {
+/*
+ ** Compiled chunks are cached in the registry by file name,
+ ** so repeated runs of a script do not go through the parser again.
+ */
+static char chunks_key;
+
+static int load_script(lua_State *L, const char *fname) {
+    int status;
+    if (fname == NULL) { /* stdin can be read only once */
+        return luaL_loadfile(L, fname);
+    }
+    if (LUA_TTABLE != lua_rawgetp(L, LUA_REGISTRYINDEX, &chunks_key)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_rawsetp(L, LUA_REGISTRYINDEX, &chunks_key);
+    }
+    if (LUA_TFUNCTION == lua_getfield(L, -1, fname)) {
+        lua_remove(L, -2);
+        return LUA_OK;
+    }
+    lua_pop(L, 1);
+    status = luaL_loadfile(L, fname);
+    if (status == LUA_OK) {
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, fname);
+    }
+    lua_remove(L, -2);
+    return status;
+}
+
+/*
+ ** Every run of a script gets its own fresh global environment:
+ ** an empty table falling back to _G, set as the chunk's _ENV.
+ ** Globals set by one run are not seen by the next one.
+ */
+static char runenv_key;
+
+static void push_runenv(lua_State *L) {
+    lua_newtable(L);
+    if (LUA_TTABLE != lua_rawgetp(L, LUA_REGISTRYINDEX, &runenv_key)) {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 1);
+        lua_pushglobaltable(L);
+        lua_setfield(L, -2, "__index");
+        lua_pushvalue(L, -1);
+        lua_rawsetp(L, LUA_REGISTRYINDEX, &runenv_key);
+    }
+    lua_setmetatable(L, -2);
+}
+
+static int handle_script(lua_State *L, char **argv, int iteration) {
     int status;
     const char *fname = argv[0];
     if (strcmp(fname, "-") == 0 && strcmp(argv[-1], "--") != 0)
         fname = NULL; /* stdin */
-    status = luaL_loadfile(L, fname);
+    status = load_script(L, fname);
     if (status == LUA_OK) {
-    	log_info("starting script: %s", fname);
+    	log_info("starting script: %s #%d", fname, iteration);
+    	push_runenv(L);
+    	lua_setupvalue(L, -2, 1); /* _ENV of main chunk */
         int n = pushargs(L); /* push arguments to script */
         status = docall(L, n, LUA_MULTRET);
     }
+    trace_flush();
     return report(L, status);
 }
 
+/* grace period between escalating signals, s */
+#define KILL_GRACE 2
+
+/*
+ ** One job: the script with the random stream of its iteration, under
+ ** alarm(timeout) when no supervisor watches it (serial mode). The
+ ** alarm breaks a blocking syscall with EINTR (no SA_RESTART) and hooks
+ ** the interpreter; a job still running KILL_GRACE later (it retried
+ ** the syscall or caught the error) dies of the second, default alarm.
+ ** With -F the job runs in a child forked from the warmed state
+ ** (libraries loaded, -l done) and its heap goes with the child: every
+ ** job starts from the same state and the collector never traces the
+ ** garbage of the previous one. The child hands back its status and
+ ** assertion failures through a shared page; the parent escalates to
+ ** SIGTERM and SIGKILL like the pool if the child outlives its alarms.
+ */
+static struct {
+    int status;
+    int failures;
+    LktkGcStats gc;
+} *job_result;
+
+static void job_timeout(int i) {
+    laction(i); /* SIGALRM is back to default: the next one terminates */
+    alarm(KILL_GRACE);
+}
+
+static int run_job_here(lua_State *L, char **argv, int script,
+        int iteration, int timeout) {
+    int status;
+    if (timeout > 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = job_timeout; /* no SA_RESTART */
+        sigemptyset(&sa.sa_mask);
+        globalL = L;
+        sigaction(SIGALRM, &sa, NULL);
+        alarm(timeout);
+    }
+    lktk_gc_begin(L);
+    status = handle_script(L, argv + script, iteration);
+    alarm(0);
+    signal(SIGALRM, SIG_DFL);
+    lktk_gc_end(L, !fresh_jobs); /* a child of -F drops its heap anyway */
+    return status;
+}
+
+/*
+ ** Waits for a -F child; past its own alarms it gets SIGTERM, then
+ ** SIGKILL, then it is abandoned (e.g. stuck in D state). Returns 0 if
+ ** the child is gone.
+ */
+static int wait_job(pid_t pid, int timeout, int *wstatus) {
+    int pidfd = -1;
+    int stage = 0;
+    int wait_ms = (timeout + KILL_GRACE) * 1000;
+    if (timeout > 0)
+        pidfd = (int)syscall(__NR_pidfd_open, pid, 0);
+    while (pidfd >= 0) {
+        struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+        int n = poll(&pfd, 1, wait_ms);
+        if (n < 0 && EINTR == errno)
+            continue;
+        if (0 != n)
+            break;
+        if (stage == 2) {
+            close(pidfd);
+            return -1;
+        }
+        kill(pid, (0 == stage++) ? SIGTERM : SIGKILL);
+        wait_ms = KILL_GRACE * 1000;
+    }
+    if (pidfd >= 0)
+        close(pidfd);
+    while (waitpid(pid, wstatus, 0) < 0 && EINTR == errno)
+        ;
+    return 0;
+}
+
+static int run_job(lua_State *L, char **argv, int script, int iteration,
+        int timeout) {
+    pid_t pid;
+    int wstatus;
+    lktk_rand_job(script, iteration);
+    if (!fresh_jobs) {
+        return run_job_here(L, argv, script, iteration, timeout);
+    }
+    if (!job_result) {
+        job_result = mmap(NULL, sizeof(*job_result), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == job_result) {
+            job_result = NULL;
+            l_message(progname, "cannot map job results, no -F");
+            fresh_jobs = 0;
+            return run_job_here(L, argv, script, iteration, timeout);
+        }
+    }
+    job_result->status = LUA_ERRRUN; /* unless the child gets to say */
+    job_result->failures = 0;
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (0 > pid) {
+        l_message(progname, "cannot fork");
+        return LUA_ERRRUN;
+    }
+    if (0 == pid) {
+        int failures = kit.failures;
+        prctl(PR_SET_PDEATHSIG, SIGKILL); /* a killed worker takes it along */
+        kmsg_watch_forget();
+        trace_forget();
+        job_result->status = run_job_here(L, argv, script, iteration, timeout);
+        job_result->failures = kit.failures - failures;
+        job_result->gc = lktk_gc_last;
+        fflush(stdout);
+        fflush(stderr);
+        _exit(EXIT_SUCCESS);
+    }
+    if (0 != wait_job(pid, timeout, &wstatus)) {
+        /* does not die even on SIGKILL */
+        echo_error("%s #%d: abandoned", argv[script], iteration);
+        job_result = NULL; /* it may still write there */
+        return LUA_ERRRUN;
+    }
+    if (WIFSIGNALED(wstatus)) {
+        echo_error("%s #%d: killed by signal %d", argv[script], iteration,
+                WTERMSIG(wstatus));
+    }
+    kit.failures += job_result->failures;
+    lktk_gc_last = job_result->gc;
+    return job_result->status;
+}
+
 /*
  ** Processes options 'e' and 'l', which involve running Lua code.
  ** Returns 0 if some code raises an error.
@@ -539,6 +820,395 @@ static const luaL_Reg kerntest_preload_libs[] = {
 	{ NULL, NULL }
 };
 
+/************** worker pool ***************************/
+
+/*
+ ** With -p N, N workers are forked once, after libraries are loaded.
+ ** Parent sends (script, iteration) jobs over a pipe, each worker runs
+ ** jobs on its own (already warm) state and reports back over another
+ ** pipe. Records are smaller than PIPE_BUF, so reads and writes of
+ ** whole records are atomic even with many workers on one pipe.
+ **
+ ** The parent is a supervisor: one epoll loop over the report pipe,
+ ** the job pipe, and a pidfd + timerfd per worker. A worker reports
+ ** START before a job, which arms its timer to kit.timeout; an overrun
+ ** gets SIGTERM, then SIGKILL, then the worker is abandoned (e.g. stuck
+ ** in D state). Dead workers are reaped with wait4 for CPU time and
+ ** replaced while jobs are left.
+ */
+struct TLktkJob {
+    int script;
+    int iteration;
+};
+typedef struct TLktkJob LktkJob;
+
+#define REPORT_START 1
+#define REPORT_DONE 2
+
+struct TLktkReport {
+    pid_t pid;
+    int kind;
+    int script;
+    int iteration;
+    int status;
+    int failures;
+    unsigned int taint; /* bits set during the job */
+    struct timespec when; /* CLOCK_MONOTONIC */
+};
+typedef struct TLktkReport LktkReport;
+
+struct TLktkWorker {
+    pid_t pid;
+    int pidfd;
+    int timerfd;
+    int busy;
+    int stage; /* 0 - running, 1 - SIGTERM sent, 2 - SIGKILL sent */
+    int span;  /* of current job in supervisor history */
+    LktkJob job;
+    struct timespec spawned;
+};
+typedef struct TLktkWorker LktkWorker;
+
+/* epoll event data: kind << 32 | worker index */
+#define EV_REPORTS 1ULL
+#define EV_JOBS 2ULL
+#define EV_PIDFD 3ULL
+#define EV_TIMER 4ULL
+#define EV_KMSG 5ULL
+#define EV_DATA(kind, i) (((kind) << 32) | (unsigned)(i))
+
+static double elapsed(const struct timespec *from) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - from->tv_sec) + (now.tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static void arm_timer(int fd, int seconds) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = seconds;
+    timerfd_settime(fd, 0, &its, NULL);
+}
+
+static void worker_loop(lua_State *L, char **argv, int jobs_fd, int reports_fd) {
+    LktkJob job;
+    LktkReport rep;
+    rep.pid = getpid();
+    while (read(jobs_fd, &job, sizeof(job)) == sizeof(job)) {
+        kit.failures = 0;
+        rep.script = job.script;
+        rep.iteration = job.iteration;
+        rep.kind = REPORT_START;
+        rep.status = rep.failures = 0;
+        rep.taint = 0;
+        clock_gettime(CLOCK_MONOTONIC, &rep.when);
+        if (write(reports_fd, &rep, sizeof(rep)) != sizeof(rep)) {
+            break;
+        }
+        taint_begin();
+        rec_begin(argv[job.script], job.iteration);
+        rep.status = run_job(L, argv, job.script, job.iteration, 0);
+        rep.taint = taint_end(argv[job.script], job.iteration);
+        rep.failures = kit.failures;
+        rec_end(rep.status != LUA_OK || rep.failures || did_kernel_error());
+        rep.kind = REPORT_DONE;
+        clock_gettime(CLOCK_MONOTONIC, &rep.when);
+        lua_settop(L, 0);
+        if (kit.verbose) {
+            print_status(L);
+        }
+        if (write(reports_fd, &rep, sizeof(rep)) != sizeof(rep)) {
+            break;
+        }
+    }
+    exit(EXIT_SUCCESS);
+}
+
+static int spawn_worker(lua_State *L, char **argv, LktkWorker *w,
+        int idx, int epfd, int jobs[2], int reports[2]) {
+    struct epoll_event ev;
+    memset(w, 0, sizeof(*w));
+    w->pidfd = w->timerfd = -1;
+    fflush(stdout);
+    w->pid = fork();
+    if (0 > w->pid) {
+        l_message(progname, "cannot fork");
+        return -1;
+    }
+    if (0 == w->pid) {
+        kmsg_watch_forget(); /* parent keeps watching */
+        trace_forget();
+        close(epfd);
+        if (jobs[1] >= 0) close(jobs[1]);
+        close(reports[0]);
+        worker_loop(L, argv, jobs[0], reports[1]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &w->spawned);
+    w->pidfd = (int)syscall(__NR_pidfd_open, w->pid, 0);
+    w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (w->pidfd < 0 || w->timerfd < 0) {
+        l_message(progname, "cannot watch worker (pidfd_open/timerfd)");
+        kill(w->pid, SIGKILL);
+        waitpid(w->pid, NULL, 0);
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_DATA(EV_PIDFD, idx);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, w->pidfd, &ev);
+    ev.data.u64 = EV_DATA(EV_TIMER, idx);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, w->timerfd, &ev);
+    if (kit.verbose) {
+        echo_debug("worker %d started", w->pid);
+    }
+    return 0;
+}
+
+static void drop_worker(LktkWorker *w, int epfd) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, w->pidfd, NULL);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, w->timerfd, NULL);
+    close(w->pidfd);
+    close(w->timerfd);
+    w->pidfd = w->timerfd = -1;
+    w->pid = 0;
+}
+
+/* when each recent job ran, for kernel message attribution */
+#define JOB_HISTORY 64
+
+struct TLktkJobSpan {
+    LktkJob job;
+    struct timespec start;
+    struct timespec end; /* zero while running */
+};
+typedef struct TLktkJobSpan LktkJobSpan;
+
+struct TLktkSupervisor {
+    LktkWorker *pool;
+    int workers;
+    int done;
+    int failed;
+    char **argv;
+    LktkJobSpan spans[JOB_HISTORY];
+    unsigned nspans;
+};
+typedef struct TLktkSupervisor LktkSupervisor;
+
+/*
+ ** Kernel message timestamps and CLOCK_MONOTONIC both count from boot,
+ ** so a message is attributed to every job whose span covers it.
+ ** printk clock runs on its own (sched_clock) and may be ahead or behind
+ ** by a fraction of ms, hence the slack.
+ */
+#define KMSG_SLACK_US 2000
+static void label_jobs(void *data, const struct timeval *when,
+        char *label, size_t size) {
+    LktkSupervisor *sv = (LktkSupervisor *)data;
+    size_t len = 0;
+    long long t = when->tv_sec * 1000000LL + when->tv_usec;
+    unsigned i = (sv->nspans > JOB_HISTORY) ? sv->nspans - JOB_HISTORY : 0;
+    for (; i < sv->nspans && len < size; i++) {
+        LktkJobSpan *s = &sv->spans[i % JOB_HISTORY];
+        long long start = s->start.tv_sec * 1000000LL + s->start.tv_nsec / 1000;
+        long long end = s->end.tv_sec * 1000000LL + s->end.tv_nsec / 1000;
+        if (t + KMSG_SLACK_US >= start
+                && (0 == end || t <= end + KMSG_SLACK_US)) {
+            len += snprintf(label + len, size - len, "%s%s #%d",
+                    len ? ", " : "", sv->argv[s->job.script],
+                    s->job.iteration);
+        }
+    }
+}
+
+static void drain_reports(LktkSupervisor *sv, int fd) {
+    LktkReport rep;
+    int i;
+    while (read(fd, &rep, sizeof(rep)) == sizeof(rep)) {
+        for (i = 0; i < sv->workers; i++) {
+            if (sv->pool[i].pid == rep.pid) break;
+        }
+        if (i == sv->workers) {
+            continue; /* abandoned worker */
+        }
+        LktkWorker *w = &sv->pool[i];
+        if (REPORT_START == rep.kind) {
+            w->busy = 1;
+            w->job.script = rep.script;
+            w->job.iteration = rep.iteration;
+            w->span = sv->nspans++ % JOB_HISTORY;
+            sv->spans[w->span].job = w->job;
+            sv->spans[w->span].start = rep.when;
+            memset(&sv->spans[w->span].end, 0, sizeof(struct timespec));
+            if (kit.timeout > 0) {
+                arm_timer(w->timerfd, kit.timeout);
+            }
+            continue;
+        }
+        w->busy = 0;
+        sv->spans[w->span].end = rep.when;
+        arm_timer(w->timerfd, 0);
+        sv->done++;
+        taint_blame(rep.taint, sv->argv[rep.script], rep.iteration);
+        if (rep.status != LUA_OK || rep.failures || (rep.taint & TAINT_ERROR)) {
+            sv->failed++;
+            kit.failures += rep.failures;
+            if (kit.verbose) {
+                echo_error("%d: %s:%d failed (seed %llu)", rep.pid,
+                        sv->argv[rep.script], rep.iteration, kit.seed);
+            }
+        }
+    }
+}
+
+static int run_pool(lua_State *L, int argc, char **argv) {
+    int jobs[2], reports[2];
+    int i, epfd, workers = kit.parallel, alive = 0;
+    /* by default each script runs once per worker */
+    int iterations = kit.iterations ? kit.iterations : workers;
+    int total = argc * iterations, sent = 0;
+    LktkJob job = {0, 0};
+    LktkWorker *pool;
+    LktkSupervisor sv;
+    struct epoll_event ev, events[16];
+    if (pipe(jobs) || pipe(reports)) {
+        l_message(progname, "cannot create pipes");
+        return EXIT_FAILURE;
+    }
+    pool = (LktkWorker *)lua_newuserdata(L, workers * sizeof(LktkWorker));
+    sv.pool = pool;
+    sv.workers = workers;
+    sv.done = sv.failed = 0;
+    sv.argv = argv;
+    sv.nspans = 0;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (i = 0; i < workers; i++) {
+        if (spawn_worker(L, argv, &pool[i], i, epfd, jobs, reports)) {
+            return EXIT_FAILURE;
+        }
+        alive++;
+    }
+    fcntl(jobs[1], F_SETFL, O_NONBLOCK);
+    fcntl(reports[0], F_SETFL, O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_DATA(EV_REPORTS, 0);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, reports[0], &ev);
+    ev.events = EPOLLOUT;
+    ev.data.u64 = EV_DATA(EV_JOBS, 0);
+    epoll_ctl(epfd, EPOLL_CTL_ADD, jobs[1], &ev);
+    if (kmsg_watch_open() >= 0) {
+        kmsg_watch_attrib(label_jobs, &sv);
+        ev.events = EPOLLIN;
+        ev.data.u64 = EV_DATA(EV_KMSG, 0);
+        epoll_ctl(epfd, EPOLL_CTL_ADD, kmsg_watch_fd(), &ev);
+    }
+
+    while (alive > 0) {
+        int n = epoll_wait(epfd, events, 16, -1);
+        if (n < 0 && EINTR != errno) {
+            break;
+        }
+        for (int e = 0; e < n; e++) {
+            unsigned long long kind = events[e].data.u64 >> 32;
+            LktkWorker *w = &pool[events[e].data.u64 & 0xffffffffU];
+            if (EV_KMSG == kind) {
+                drain_reports(&sv, reports[0]); /* spans first */
+                kmsg_watch_drain();
+            } else if (EV_JOBS == kind) {
+                /* keep the job pipe full */
+                while (sent < total
+                        && write(jobs[1], &job, sizeof(job)) == sizeof(job)) {
+                    sent++;
+                    if (++job.script == argc) {
+                        job.script = 0;
+                        job.iteration++;
+                    }
+                }
+                if (sent == total) {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, jobs[1], NULL);
+                    close(jobs[1]); /* workers exit on EOF */
+                    jobs[1] = -1;
+                }
+            } else if (EV_REPORTS == kind) {
+                drain_reports(&sv, reports[0]);
+            } else if (EV_TIMER == kind) {
+                uint64_t expirations;
+                if (read(w->timerfd, &expirations, sizeof(expirations)) < 0) {
+                    continue;
+                }
+                if (0 == w->stage) {
+                    echo_error("%d: %s:%d timed out after %ds", w->pid,
+                            argv[w->job.script], w->job.iteration,
+                            kit.timeout);
+                }
+                if (w->stage < 2) {
+                    kill(w->pid, (0 == w->stage) ? SIGTERM : SIGKILL);
+                    w->stage++;
+                    arm_timer(w->timerfd, KILL_GRACE);
+                    continue;
+                }
+                /* does not die even on SIGKILL */
+                echo_error("%d: abandoned", w->pid);
+                drop_worker(w, epfd);
+                alive--;
+                sv.done++;
+                sv.failed++;
+            } else if (EV_PIDFD == kind) {
+                int wstatus;
+                struct rusage ru;
+                pid_t pid = w->pid;
+                int idx = (int)(w - pool);
+                if (wait4(pid, &wstatus, 0, &ru) != pid) {
+                    continue;
+                }
+                double cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+                        + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+                if (WIFEXITED(wstatus) && (WEXITSTATUS(wstatus)==0)) {
+                    if (kit.verbose) {
+                        echo_good("%d exited ok (wall %.3fs, cpu %.3fs)",
+                                pid, elapsed(&w->spawned), cpu);
+                    }
+                } else {
+                    echo_error("%d exited badly (wall %.3fs, cpu %.3fs)",
+                            pid, elapsed(&w->spawned), cpu);
+                }
+                drain_reports(&sv, reports[0]); /* its last DONE */
+                if (w->busy) {
+                    /* job died with its worker */
+                    echo_error("%d: %s:%d did not finish", pid,
+                            argv[w->job.script], w->job.iteration);
+                    sv.done++;
+                    sv.failed++;
+                }
+                drop_worker(w, epfd);
+                alive--;
+                /* replace the worker while jobs are left */
+                int busy = 0;
+                for (i = 0; i < workers; i++) {
+                    busy += pool[i].busy;
+                }
+                if (sv.done + busy < total) {
+                    if (0 == spawn_worker(L, argv, w, idx, epfd, jobs, reports)) {
+                        alive++;
+                    }
+                }
+            }
+        }
+    }
+    if (jobs[1] >= 0) {
+        close(jobs[1]);
+    }
+    close(jobs[0]);
+    close(reports[0]);
+    close(reports[1]);
+    close(epfd);
+    kmsg_watch_attrib(NULL, NULL);
+    lua_pop(L, 1); /* pool */
+    if (kit.verbose) {
+        echo_info("jobs: %d of %d done, %d failed",
+                sv.done, total, sv.failed);
+    }
+    return (sv.done == total && !sv.failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 /*
  ** Main body of stand-alone interpreter (to be called in protected mode).
  ** Reads the options and handles them all.
@@ -569,6 +1239,15 @@ static int pmain(lua_State *L) {
 
     inject_lktklib(L);
     inject_lktkassert(L);
+    inject_lktkuring(L);
+    inject_lktkstruct(L);
+    inject_lktkbuf(L);
+    inject_lktksyscalls(L);
+    inject_lktkfuzz(L);
+    inject_lktkflags(L);
+    inject_lktkrand(L);
+    inject_lktkalloc(L);
+    inject_lktkgc(L);
 
     // TODO: should scripts have args?
     /* create table 'arg' - TODO: fake call */
@@ -587,53 +1266,38 @@ static int pmain(lua_State *L) {
 	}
 
     /* execute all the scripts */
-    // TODO: do 'interations' times
 	// in 'mutant' mode start by mutating only last syscall
 	// and then radndomize upper and upper..
-    // TODO: if processes == 1 dont spawn child
 #define processes (kit.parallel)
     if (0 < argc) {
-    	int cur_script = 0;
-    	while (cur_script < argc) {
-    		if (!processes) {
-				handle_script(L, argv + cur_script);
-				if (kit.verbose) print_status(L);
-    		} else {
-				for (int i=0; i<processes; i++) {
-				    if (kit.verbose) {
-				        echo_debug("forking script %s:%d", argv[cur_script], i);
-				    }
-					int pid = fork();
-					if (0 > pid) {
-						l_message(argv[0], "cannot fork");
-						return EXIT_FAILURE;
-					}
-					if (0 == pid) {
-						// TODO: check if != LUA_OK
-						handle_script(L, argv + cur_script);
-					    if (kit.verbose) {
-					        print_status(L);
-					    }
-						exit(EXIT_SUCCESS /* TODO: check if EXIT_FAILURE*/ );
-					}
-				}
-    		}
-    		cur_script++;
-    	}
-    	if (processes) {
-			int wstatus, ret_pid;
-			while((ret_pid = waitpid(-1, &wstatus, 0)) > 0) {
-				if (WIFEXITED(wstatus) && (WEXITSTATUS(wstatus)==0)) {
-				    if (kit.verbose) {
-				    	echo_good("%d exited ok", ret_pid);
-				    }
-				} else {
-				    if (kit.verbose) {
-				    	echo_error("%d exited badly", ret_pid);
-				    }
-				}
-			}
-    	}
+        taint_start();
+        log_info("seed: %llu", kit.seed);
+        if (!processes) {
+            int iterations = kit.iterations ? kit.iterations : 1;
+            int cur_script = 0;
+            kmsg_watch_start();
+            while (cur_script < argc) {
+                for (int i = 0; i < iterations; i++) {
+                    kmsg_watch_label("%s #%d", argv[cur_script], i);
+                    int failures = kit.failures;
+                    int status;
+                    taint_begin();
+                    rec_begin(argv[cur_script], i);
+                    /* no supervisor here: alarm */
+                    status = run_job(L, argv, cur_script, i, kit.timeout);
+                    taint_end(argv[cur_script], i);
+                    rec_end(status != LUA_OK || kit.failures != failures
+                            || did_kernel_error());
+                    lua_settop(L, 0);
+                    if (kit.verbose) print_status(L);
+                }
+                cur_script++;
+            }
+            kmsg_watch_stop();
+        } else {
+            run_pool(L, argc, argv);
+        }
+        taint_stop();
     } // scripts
 #undef processes
 
@@ -664,6 +1328,15 @@ static void print_usage() {
             "  -A       abort on failed assert\n"
             "  -x       no asserts\n"
             "  -q       be queit\n"
+            "  -p n     run scripts on pool of n worker processes\n"
+            "  -c n     run each script n times (default: once per worker)\n"
+            "  -T s     kill script running longer than s seconds\n"
+            "  -S seed  seed of random numbers (replays a run)\n"
+            "  -R dir   record syscalls of failed jobs to dir/*.trace\n"
+            "  -r file  replay a recorded trace (no Lua)\n"
+            "  -F       fork every job from the initialized state\n"
+            "  -G gc    collector policy: inc[:pause[:stepmul]], iteration,\n"
+            "           step[:n] (n GC steps after each syscall)\n"
             "  -k       check kernel stuff\n"
             "  -s       collect sys stats\n"
             "  -t       collect traces\n"
@@ -694,6 +1367,11 @@ static void parse_cmdline(int argc, char **args, int* first, lua_State *L) {
         {"process",      1, NULL, 'p'},
         {"timeout",      1, NULL, 'T'},
         {"count",        1, NULL, 'c'},
+        {"seed",         1, NULL, 'S'},
+        {"record",       1, NULL, 'R'},
+        {"replay",       1, NULL, 'r'},
+        {"fresh",        0, NULL, 'F'},
+        {"gc",           1, NULL, 'G'},
         {"quiet",        0, NULL, 'q'},
         {"syslog",       0, NULL, 'L'},
         {"noassert",     0, NULL, 'x'},
@@ -705,7 +1383,7 @@ static void parse_cmdline(int argc, char **args, int* first, lua_State *L) {
     while (1) {
     	int x;
         int c;
-        if ((c = getopt_long(argc, args, "eil:Ep:kstc:T:AxLvq", long_option, NULL)) < 0) {
+        if ((c = getopt_long(argc, args, "eil:Ep:kstc:T:S:R:r:FG:AxLvq", long_option, NULL)) < 0) {
             break;
         }
         switch (c) {
@@ -727,6 +1405,32 @@ static void parse_cmdline(int argc, char **args, int* first, lua_State *L) {
                 goto error_happened;
             }
             break;
+        case 'T':
+            if (sscanf(optarg, "%d" , &x) == 1 ) {
+            	kit.timeout = x;
+            } else {
+                goto error_happened;
+            }
+            break;
+        case 'S':
+            if (sscanf(optarg, "%llu", &kit.seed) != 1) {
+                goto error_happened;
+            }
+            break;
+        case 'R':
+            lktk_rec_dir = optarg;
+            break;
+        case 'r':
+            replay_file = optarg;
+            break;
+        case 'F':
+            fresh_jobs = 1;
+            break;
+        case 'G':
+            if (lktk_gc_parse(optarg, &lktk_gc_default)) {
+                goto error_happened;
+            }
+            break;
         case 'p':
             if (sscanf(optarg, "%d" , &x) == 1 ) {
             	kit.parallel = x;
@@ -773,7 +1477,7 @@ static void stop(lua_State *L) {
 		closelog();
 	}
 	/* TODO: L is meaningless here (due to fork)) */
-	lua_close(L);
+	lktk_closestate(L);
 }
 
 int main(int argc, char **argv) {
@@ -781,13 +1485,18 @@ int main(int argc, char **argv) {
 	int script;
 
     // TODO: question create L once or for each fork?
-	lua_State *L = luaL_newstate();
+	lua_State *L = lktk_newstate();
 	if (L == NULL) {
 		l_message(argv[0], "cannot create state: not enough memory");
 		return EXIT_FAILURE;
 	}
 
+    kit.seed = lktk_rand_entropy();
     parse_cmdline(argc, argv, &script, L);
+    if (replay_file) {
+        lktk_closestate(L);
+        return lktk_replay(replay_file) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 
     start(L);
 
@@ -0,0 +1,235 @@
+#include "lktkalloc.h"
+#include <sys/mman.h>
+
+/*
+ * Allocation statistics
+ *   alloc.stats()   {allocs, frees, reallocs, large, bytes, peak,
+ *                    slabs, slab_bytes, classes = {[size] = blocks}}
+ *   alloc.reset()   counters from 0, peak from the bytes held now
+ * Lua allocates through the slabs of lktkalloc.h, so a loop building
+ * struct tables and short strings reuses the blocks of the previous
+ * iteration instead of going through malloc every time.
+ */
+
+#define SLAB_SIZE (64 << 10)
+
+#define size_class(n) (((n) + 15) / 16 - 1)
+#define class_size(c) (((size_t)(c) + 1) * 16)
+
+/* at the start of every slab, keeps the slab list */
+struct TLktkSlab {
+    struct TLktkSlab *next;
+};
+typedef struct TLktkSlab LktkSlab;
+
+#define SLAB_HDR ((sizeof(LktkSlab) + 15) & ~(size_t)15)
+
+struct TLktkClass {
+    void *free;   /* freed blocks, linked through their first word */
+    char *cur;    /* never used part of the newest slab */
+    char *end;
+};
+typedef struct TLktkClass LktkClass;
+
+struct TLktkHeap {
+    LktkClass classes[LKTK_ALLOC_CLASSES];
+    LktkSlab *slabs;
+    LktkAllocStats st;
+};
+typedef struct TLktkHeap LktkHeap;
+
+static int slab_refill(LktkHeap *h, LktkClass *c) {
+    LktkSlab *s = mmap(NULL, SLAB_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == s) {
+        return -1;
+    }
+    s->next = h->slabs;
+    h->slabs = s;
+    h->st.slabs++;
+    c->cur = (char *)s + SLAB_HDR;
+    c->end = (char *)s + SLAB_SIZE;
+    return 0;
+}
+
+static void *small_alloc(LktkHeap *h, int cls) {
+    LktkClass *c = &h->classes[cls];
+    size_t size = class_size(cls);
+    void *p = c->free;
+    if (p) {
+        c->free = *(void **)p;
+    } else {
+        if (c->cur + size > c->end && slab_refill(h, c)) {
+            return NULL;
+        }
+        p = c->cur;
+        c->cur += size;
+    }
+    h->st.live[cls]++;
+    return p;
+}
+
+static void small_free(LktkHeap *h, void *p, int cls) {
+    LktkClass *c = &h->classes[cls];
+    *(void **)p = c->free;
+    c->free = p;
+    h->st.live[cls]--;
+}
+
+static void *block_alloc(LktkHeap *h, size_t n) {
+    if (n <= LKTK_ALLOC_SMALL) {
+        return small_alloc(h, size_class(n));
+    }
+    h->st.large++;
+    return malloc(n);
+}
+
+static void block_free(LktkHeap *h, void *p, size_t n) {
+    if (n <= LKTK_ALLOC_SMALL) {
+        small_free(h, p, size_class(n));
+    } else {
+        free(p);
+    }
+}
+
+/* lua_Alloc: osize is the block size whenever ptr is not NULL */
+static void *heap_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+    LktkHeap *h = (LktkHeap *)ud;
+    void *p;
+    if (!ptr) {
+        osize = 0; /* the type of the new object */
+    }
+    if (0 == nsize) {
+        if (ptr) {
+            block_free(h, ptr, osize);
+            h->st.frees++;
+            h->st.bytes -= osize;
+        }
+        return NULL;
+    }
+    if (!ptr) {
+        p = block_alloc(h, nsize);
+        h->st.allocs++;
+    } else if (osize > LKTK_ALLOC_SMALL && nsize > LKTK_ALLOC_SMALL) {
+        p = realloc(ptr, nsize);
+        h->st.reallocs++;
+    } else if (osize <= LKTK_ALLOC_SMALL && nsize <= LKTK_ALLOC_SMALL
+            && size_class(osize) == size_class(nsize)) {
+        h->st.reallocs++;
+        p = ptr; /* fits where it is */
+    } else {
+        p = block_alloc(h, nsize);
+        if (p) {
+            memcpy(p, ptr, osize < nsize ? osize : nsize);
+            block_free(h, ptr, osize);
+        }
+        h->st.reallocs++;
+    }
+    if (p) {
+        h->st.bytes += nsize - osize;
+        if (h->st.bytes > h->st.peak) {
+            h->st.peak = h->st.bytes;
+        }
+    }
+    return p;
+}
+
+static void heap_destroy(LktkHeap *h) {
+    LktkSlab *s = h->slabs;
+    while (s) {
+        LktkSlab *next = s->next;
+        munmap(s, SLAB_SIZE);
+        s = next;
+    }
+    free(h);
+}
+
+static int panic(lua_State *L) {
+    lua_writestringerror("PANIC: unprotected error in call to Lua API (%s)\n",
+            lua_tostring(L, -1));
+    return 0; /* return to Lua to abort */
+}
+
+lua_State *lktk_newstate(void) {
+    LktkHeap *h = calloc(1, sizeof(LktkHeap));
+    lua_State *L;
+    if (!h) {
+        return NULL;
+    }
+    L = lua_newstate(heap_alloc, h);
+    if (!L) {
+        heap_destroy(h);
+        return NULL;
+    }
+    lua_atpanic(L, panic);
+    return L;
+}
+
+void lktk_closestate(lua_State *L) {
+    void *h;
+    if (lua_getallocf(L, &h) != heap_alloc) {
+        lua_close(L);
+        return;
+    }
+    lua_close(L); /* finalizers run, objects go back to their class */
+    heap_destroy((LktkHeap *)h);
+}
+
+static LktkHeap *get_heap(lua_State *L) {
+    void *ud;
+    lua_getallocf(L, &ud);
+    return (LktkHeap *)ud;
+}
+
+static int allocStats(lua_State *L) {
+    LktkHeap *h = get_heap(L);
+    LktkAllocStats st = h->st; /* before the table below changes it */
+    int i;
+    lua_createtable(L, 0, 8);
+    lua_pushinteger(L, (lua_Integer)st.allocs);
+    lua_setfield(L, -2, "allocs");
+    lua_pushinteger(L, (lua_Integer)st.frees);
+    lua_setfield(L, -2, "frees");
+    lua_pushinteger(L, (lua_Integer)st.reallocs);
+    lua_setfield(L, -2, "reallocs");
+    lua_pushinteger(L, (lua_Integer)st.large);
+    lua_setfield(L, -2, "large");
+    lua_pushinteger(L, (lua_Integer)st.bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, (lua_Integer)st.peak);
+    lua_setfield(L, -2, "peak");
+    lua_pushinteger(L, (lua_Integer)st.slabs);
+    lua_setfield(L, -2, "slabs");
+    lua_pushinteger(L, (lua_Integer)(st.slabs * SLAB_SIZE));
+    lua_setfield(L, -2, "slab_bytes");
+    lua_newtable(L);
+    for (i = 0; i < LKTK_ALLOC_CLASSES; i++) {
+        if (st.live[i]) {
+            lua_pushinteger(L, (lua_Integer)st.live[i]);
+            lua_rawseti(L, -2, (lua_Integer)class_size(i));
+        }
+    }
+    lua_setfield(L, -2, "classes");
+    return 1;
+}
+
+static int allocReset(lua_State *L) {
+    LktkHeap *h = get_heap(L);
+    h->st.allocs = h->st.frees = h->st.reallocs = h->st.large = 0;
+    h->st.peak = h->st.bytes;
+    return 0;
+}
+
+static const struct luaL_Reg alloc_funcs[] = {
+    {"stats", allocStats},
+    {"reset", allocReset},
+    {NULL, NULL}
+};
+
+void inject_lktkalloc(lua_State *L) {
+    if (lua_getallocf(L, NULL) != heap_alloc) {
+        return; /* not our state (lua_newstate elsewhere) */
+    }
+    luaL_newlib(L, alloc_funcs);
+    lua_setglobal(L, "alloc");
+}
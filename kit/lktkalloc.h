@@ -0,0 +1,37 @@
+#ifndef LKTKALLOC_H
+#define LKTKALLOC_H
+
+#include "lktklib.h"
+#include <stdint.h>
+
+/*
+ * Allocator of the lktk Lua state
+ * Blocks up to LKTK_ALLOC_SMALL bytes come from size classes 16 bytes
+ * apart, carved out of 64k slabs mapped for the state; a freed block
+ * goes on the free list of its class. Lua passes the size of every
+ * block it frees or resizes, so blocks carry no header. Bigger blocks
+ * go to malloc. lktk_closestate unmaps all slabs at once.
+ */
+
+#define LKTK_ALLOC_SMALL 512
+#define LKTK_ALLOC_CLASSES (LKTK_ALLOC_SMALL / 16)
+
+struct TLktkAllocStats {
+    uint64_t allocs;   /* new blocks */
+    uint64_t frees;
+    uint64_t reallocs; /* resized blocks */
+    uint64_t large;    /* new blocks from malloc */
+    size_t bytes;      /* held by Lua */
+    size_t peak;
+    size_t slabs;
+    uint64_t live[LKTK_ALLOC_CLASSES]; /* blocks per class */
+};
+typedef struct TLktkAllocStats LktkAllocStats;
+
+/* luaL_newstate on the slab allocator */
+lua_State *lktk_newstate(void);
+void lktk_closestate(lua_State *L);
+
+void inject_lktkalloc(lua_State *L);
+
+#endif
@@ -0,0 +1,284 @@
+#include "lktkbuf.h"
+#include <sys/mman.h>
+
+/*
+ * Syscall buffers
+ *   a = arena(size [, flags])      page-aligned anonymous mapping,
+ *                                  flags: ARENA_MLOCK, ARENA_HUGE
+ *   b = a:buffer(len [, align])    carved from the arena (bump pointer)
+ *   s = b:slice(off, len)          view into a buffer
+ * Buffers are passed to syscall (and to pointer fields of structs)
+ * as their data address; nothing is allocated per call.
+ * Arena memory lives until the arena and all its buffers are
+ * collected; a:reset() reuses it from the start (old buffers then
+ * alias the new ones).
+ */
+
+#define ARENA_MT "lktk.arena"
+#define BUFFER_MT "lktk.buffer"
+
+#define ARENA_MLOCK 1
+#define ARENA_HUGE 2
+
+#define HUGE_PAGE (2UL << 20)
+
+struct TLktkArena {
+    char *base;
+    size_t size;
+    size_t used;
+    int flags;
+};
+typedef struct TLktkArena LktkArena;
+
+struct TLktkBuffer {
+    char *ptr;
+    size_t len;
+};
+typedef struct TLktkBuffer LktkBuffer;
+
+/* checked on every userdata syscall argument: compare, no lookups */
+static const void *buffer_mt;
+
+void *lktk_userdata_ptr(lua_State *L, int idx) {
+    void *ud = lua_touserdata(L, idx);
+    if (lua_getmetatable(L, idx)) {
+        int is_buffer = (lua_topointer(L, -1) == buffer_mt);
+        lua_pop(L, 1);
+        if (is_buffer) {
+            return ((LktkBuffer *)ud)->ptr;
+        }
+    }
+    return ud;
+}
+
+size_t lktk_userdata_len(lua_State *L, int idx) {
+    void *ud;
+    luaL_checktype(L, idx, LUA_TUSERDATA);
+    ud = lua_touserdata(L, idx);
+    if (lua_getmetatable(L, idx)) {
+        int is_buffer = (lua_topointer(L, -1) == buffer_mt);
+        lua_pop(L, 1);
+        if (is_buffer) {
+            return ((LktkBuffer *)ud)->len;
+        }
+    }
+    return lua_rawlen(L, idx);
+}
+
+static LktkArena *check_arena(lua_State *L) {
+    LktkArena *a = (LktkArena *)luaL_checkudata(L, 1, ARENA_MT);
+    if (!a->base) {
+        luaL_error(L, "arena: not mapped");
+    }
+    return a;
+}
+
+#define check_buffer(L, i) ((LktkBuffer *)luaL_checkudata(L, i, BUFFER_MT))
+
+static void *map_arena(size_t *size, int flags) {
+    void *p = MAP_FAILED;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (flags & ARENA_HUGE) {
+        size_t hsize = (*size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        p = mmap(NULL, hsize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (MAP_FAILED != p) {
+            *size = hsize;
+            return p;
+        }
+        log_info("arena: no hugetlb pages, using THP hint");
+    }
+    *size = (*size + page - 1) & ~(page - 1);
+    p = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED != p && (flags & ARENA_HUGE)) {
+        madvise(p, *size, MADV_HUGEPAGE);
+    }
+    return p;
+}
+
+// arena(size [, flags]) -> arena | nil, errno
+static int arenaNew(lua_State *L) {
+    size_t size = (size_t)luaL_checkinteger(L, 1);
+    int flags = (int)luaL_optinteger(L, 2, 0);
+    luaL_argcheck(L, size > 0, 1, "positive size expected");
+    LktkArena *a = (LktkArena *)lua_newuserdata(L, sizeof(LktkArena));
+    memset(a, 0, sizeof(LktkArena));
+    luaL_setmetatable(L, ARENA_MT);
+    void *p = map_arena(&size, flags);
+    if (MAP_FAILED == p) {
+        log_error("arena: mmap of %zu bytes failed: %s", size, strerror(errno));
+        lua_pushnil(L);
+        lua_pushinteger(L, errno);
+        return 2;
+    }
+    a->base = (char *)p;
+    a->size = size;
+    a->flags = flags;
+    if ((flags & ARENA_MLOCK) && mlock(p, size)) {
+        int err = errno;
+        log_error("arena: mlock failed: %s", strerror(err));
+        munmap(p, size);
+        a->base = NULL;
+        lua_pushnil(L);
+        lua_pushinteger(L, err);
+        return 2;
+    }
+    return 1;
+}
+
+static LktkBuffer *push_buffer(lua_State *L, char *ptr, size_t len,
+        int anchor) {
+    LktkBuffer *b = (LktkBuffer *)lua_newuserdata(L, sizeof(LktkBuffer));
+    b->ptr = ptr;
+    b->len = len;
+    luaL_setmetatable(L, BUFFER_MT);
+    /* keep the owner (arena or parent buffer) mapped */
+    lua_pushvalue(L, anchor);
+    lua_setuservalue(L, -2);
+    return b;
+}
+
+// a:buffer(len [, align]) -> buffer | nil, ENOMEM
+static int arenaBuffer(lua_State *L) {
+    LktkArena *a = check_arena(L);
+    size_t len = (size_t)luaL_checkinteger(L, 2);
+    size_t align = (size_t)luaL_optinteger(L, 3, 64);
+    luaL_argcheck(L, align && !(align & (align - 1)), 3,
+            "power of 2 expected");
+    size_t off = (a->used + align - 1) & ~(align - 1);
+    if (off > a->size || len > a->size - off) {
+        lua_pushnil(L);
+        lua_pushinteger(L, ENOMEM);
+        return 2;
+    }
+    a->used = off + len;
+    push_buffer(L, a->base + off, len, 1);
+    return 1;
+}
+
+static int arenaReset(lua_State *L) {
+    check_arena(L)->used = 0;
+    return 0;
+}
+
+static int arenaAvail(lua_State *L) {
+    LktkArena *a = check_arena(L);
+    lua_pushinteger(L, (lua_Integer)(a->size - a->used));
+    return 1;
+}
+
+static int arenaLen(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer)check_arena(L)->size);
+    return 1;
+}
+
+static int arenaGc(lua_State *L) {
+    LktkArena *a = (LktkArena *)luaL_checkudata(L, 1, ARENA_MT);
+    if (a->base) {
+        munmap(a->base, a->size); /* unlocks too */
+        a->base = NULL;
+    }
+    return 0;
+}
+
+/* optional (off, len) range of a buffer, checked */
+static char *buffer_range(lua_State *L, LktkBuffer *b, int idx,
+        size_t *len) {
+    size_t off = (size_t)luaL_optinteger(L, idx, 0);
+    luaL_argcheck(L, off <= b->len, idx, "offset out of buffer");
+    *len = (size_t)luaL_optinteger(L, idx + 1, (lua_Integer)(b->len - off));
+    luaL_argcheck(L, *len <= b->len - off, idx + 1, "length out of buffer");
+    return b->ptr + off;
+}
+
+// b:slice(off, len) -> buffer
+static int bufferSlice(lua_State *L) {
+    size_t len;
+    char *p = buffer_range(L, check_buffer(L, 1), 2, &len);
+    push_buffer(L, p, len, 1);
+    return 1;
+}
+
+// b:str([off [, len]]) -> string with the contents
+static int bufferStr(lua_State *L) {
+    size_t len;
+    char *p = buffer_range(L, check_buffer(L, 1), 2, &len);
+    lua_pushlstring(L, p, len);
+    return 1;
+}
+
+// b:write(s [, off]) -> bytes copied
+static int bufferWrite(lua_State *L) {
+    LktkBuffer *b = check_buffer(L, 1);
+    size_t len;
+    const char *s = luaL_checklstring(L, 2, &len);
+    size_t off = (size_t)luaL_optinteger(L, 3, 0);
+    luaL_argcheck(L, off <= b->len, 3, "offset out of buffer");
+    if (len > b->len - off) {
+        len = b->len - off;
+    }
+    memcpy(b->ptr + off, s, len);
+    lua_pushinteger(L, (lua_Integer)len);
+    return 1;
+}
+
+// b:fill(byte [, off [, len]])
+static int bufferFill(lua_State *L) {
+    size_t len;
+    LktkBuffer *b = check_buffer(L, 1);
+    int c = (int)luaL_checkinteger(L, 2);
+    char *p = buffer_range(L, b, 3, &len);
+    memset(p, c, len);
+    return 0;
+}
+
+static int bufferAddr(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer)check_buffer(L, 1)->ptr);
+    return 1;
+}
+
+static int bufferLen(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer)check_buffer(L, 1)->len);
+    return 1;
+}
+
+static const struct luaL_Reg arena_methods[] = {
+    {"buffer", arenaBuffer},
+    {"reset", arenaReset},
+    {"avail", arenaAvail},
+    {"__len", arenaLen},
+    {"__gc", arenaGc},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg buffer_methods[] = {
+    {"slice", bufferSlice},
+    {"str", bufferStr},
+    {"write", bufferWrite},
+    {"fill", bufferFill},
+    {"addr", bufferAddr},
+    {"__len", bufferLen},
+    {NULL, NULL}
+};
+
+void inject_lktkbuf(lua_State *L) {
+    luaL_newmetatable(L, ARENA_MT);
+    luaL_setfuncs(L, arena_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, BUFFER_MT);
+    luaL_setfuncs(L, buffer_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    buffer_mt = lua_topointer(L, -1);
+    lua_pop(L, 1);
+
+    lua_register(L, "arena", arenaNew);
+    lua_pushglobaltable(L);
+    LPOSIX_CONST( ARENA_MLOCK );
+    LPOSIX_CONST( ARENA_HUGE );
+    lua_pop(L, 1);
+}
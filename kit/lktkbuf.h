@@ -0,0 +1,16 @@
+#ifndef LKTKBUF_H
+#define LKTKBUF_H
+
+#include "lktklib.h"
+
+void inject_lktkbuf(lua_State *L);
+
+/*
+ * Memory a userdata argument stands for: the data of a buffer
+ * object, the block itself for any other userdata
+ */
+void *lktk_userdata_ptr(lua_State *L, int idx);
+/* and its size in bytes */
+size_t lktk_userdata_len(lua_State *L, int idx);
+
+#endif
@@ -0,0 +1,181 @@
+#include "lktkflags.h"
+#include "lktkrand.h"
+
+/*
+ * Flag sets
+ *   fs = flagset({f1, ..., fn} [, {w1, ..., wn}])   n <= 64
+ *   fs:random()       OR of a random subset; flag i is in with
+ *                     probability wi (default 0.5)
+ *   fs:value(mask)    OR of the flags whose bit is set in mask
+ *   fs:subset(k)      k-th subset in Gray code order (k from 0)
+ *   for v, mask in fs:subsets() do ... end
+ *                     all 2^n subsets in Gray code order, starting
+ *                     from 0: each step adds or drops one flag
+ *   #fs               n
+ * A subset is a bit mask over the flags, so sampling is one random
+ * number (one per 4 flags when weighted) from the job stream
+ * (lktkrand.h), and no subset tables are kept for any size.
+ */
+
+#define FLAGSET_MT "lktk.flagset"
+#define FLAGSET_MAX 64
+
+struct TLktkFlagset {
+    int n;
+    int disjoint; /* no two flags share a bit: value ^= flag per step */
+    int weighted;
+    uint64_t full; /* mask with all n flags */
+    lua_Integer vals[FLAGSET_MAX];
+    uint32_t weight[FLAGSET_MAX]; /* P(flag) * 65536 */
+};
+typedef struct TLktkFlagset LktkFlagset;
+
+#define check_flagset(L) ((LktkFlagset *)luaL_checkudata(L, 1, FLAGSET_MT))
+
+static lua_Integer flags_value(const LktkFlagset *fs, uint64_t mask) {
+    lua_Integer v = 0;
+    mask &= fs->full;
+    while (mask) {
+        v |= fs->vals[__builtin_ctzll(mask)];
+        mask &= mask - 1;
+    }
+    return v;
+}
+
+static uint64_t random_mask(const LktkFlagset *fs) {
+    uint64_t mask = 0, r = 0;
+    int i;
+    if (!fs->weighted) {
+        return lktk_rand() & fs->full;
+    }
+    for (i = 0; i < fs->n; i++) {
+        if (!(i & 3)) {
+            r = lktk_rand();
+        }
+        if ((r & 0xffff) < fs->weight[i]) {
+            mask |= 1ULL << i;
+        }
+        r >>= 16;
+    }
+    return mask;
+}
+
+// flagset({flags} [, {weights}]) -> flagset
+static int flagsetNew(lua_State *L) {
+    LktkFlagset *fs;
+    lua_Integer seen = 0;
+    int i, n;
+    lua_settop(L, 2);
+    luaL_checktype(L, 1, LUA_TTABLE);
+    n = (int)luaL_len(L, 1);
+    luaL_argcheck(L, n <= FLAGSET_MAX, 1, "at most 64 flags");
+    if (!lua_isnil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        luaL_argcheck(L, luaL_len(L, 2) == n, 2, "one weight per flag");
+    }
+    fs = (LktkFlagset *)lua_newuserdata(L, sizeof(LktkFlagset));
+    memset(fs, 0, sizeof(LktkFlagset));
+    luaL_setmetatable(L, FLAGSET_MT);
+    fs->n = n;
+    fs->full = (n == FLAGSET_MAX) ? ~0ULL : (1ULL << n) - 1;
+    fs->disjoint = 1;
+    for (i = 0; i < n; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        fs->vals[i] = luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+        if (seen & fs->vals[i]) {
+            fs->disjoint = 0;
+        }
+        seen |= fs->vals[i];
+    }
+    if (!lua_isnil(L, 2)) {
+        fs->weighted = 1;
+        for (i = 0; i < n; i++) {
+            lua_Number w;
+            lua_rawgeti(L, 2, i + 1);
+            w = luaL_checknumber(L, -1);
+            lua_pop(L, 1);
+            luaL_argcheck(L, w >= 0 && w <= 1, 2, "weights are in [0, 1]");
+            fs->weight[i] = (uint32_t)(w * 65536);
+        }
+    }
+    return 1;
+}
+
+static int flagsetRandom(lua_State *L) {
+    LktkFlagset *fs = check_flagset(L);
+    lua_pushinteger(L, flags_value(fs, random_mask(fs)));
+    return 1;
+}
+
+static int flagsetValue(lua_State *L) {
+    LktkFlagset *fs = check_flagset(L);
+    lua_pushinteger(L, flags_value(fs, (uint64_t)luaL_checkinteger(L, 2)));
+    return 1;
+}
+
+static int flagsetSubset(lua_State *L) {
+    LktkFlagset *fs = check_flagset(L);
+    uint64_t k = (uint64_t)luaL_checkinteger(L, 2);
+    lua_pushinteger(L, flags_value(fs, k ^ (k >> 1)));
+    return 1;
+}
+
+/* upvalues: flagset, steps taken, mask, value */
+static int subsetsNext(lua_State *L) {
+    LktkFlagset *fs = (LktkFlagset *)lua_touserdata(L, lua_upvalueindex(1));
+    uint64_t k = (uint64_t)lua_tointeger(L, lua_upvalueindex(2));
+    uint64_t mask = (uint64_t)lua_tointeger(L, lua_upvalueindex(3));
+    lua_Integer v = lua_tointeger(L, lua_upvalueindex(4));
+    if (k) {
+        int bit;
+        if (fs->n < FLAGSET_MAX && k >> fs->n) {
+            return 0; /* all 2^n done */
+        }
+        bit = __builtin_ctzll(k);
+        mask ^= 1ULL << bit;
+        v = fs->disjoint ? (v ^ fs->vals[bit]) : flags_value(fs, mask);
+    }
+    lua_pushinteger(L, (lua_Integer)(k + 1));
+    lua_replace(L, lua_upvalueindex(2));
+    lua_pushinteger(L, (lua_Integer)mask);
+    lua_replace(L, lua_upvalueindex(3));
+    lua_pushinteger(L, v);
+    lua_replace(L, lua_upvalueindex(4));
+    lua_pushinteger(L, v);
+    lua_pushinteger(L, (lua_Integer)mask);
+    return 2;
+}
+
+static int flagsetSubsets(lua_State *L) {
+    check_flagset(L);
+    lua_settop(L, 1);
+    lua_pushinteger(L, 0);
+    lua_pushinteger(L, 0);
+    lua_pushinteger(L, 0);
+    lua_pushcclosure(L, subsetsNext, 4);
+    return 1;
+}
+
+static int flagsetLen(lua_State *L) {
+    lua_pushinteger(L, check_flagset(L)->n);
+    return 1;
+}
+
+static const struct luaL_Reg flagset_methods[] = {
+    {"random", flagsetRandom},
+    {"value", flagsetValue},
+    {"subset", flagsetSubset},
+    {"subsets", flagsetSubsets},
+    {"__len", flagsetLen},
+    {NULL, NULL}
+};
+
+void inject_lktkflags(lua_State *L) {
+    luaL_newmetatable(L, FLAGSET_MT);
+    luaL_setfuncs(L, flagset_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    lua_register(L, "flagset", flagsetNew);
+}
@@ -0,0 +1,8 @@
+#ifndef LKTKFLAGS_H
+#define LKTKFLAGS_H
+
+#include "lktklib.h"
+
+void inject_lktkflags(lua_State *L);
+
+#endif
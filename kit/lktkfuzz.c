@@ -0,0 +1,629 @@
+#include "lktkfuzz.h"
+#include "lktklog.h"
+#include "lktksyscalls.h"
+#include "lktkrand.h"
+#include "lktkrec.h"
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/kcov.h>
+
+/*
+ * Coverage guided fuzzing
+ *   f = fuzzer{calls = {nr, ...}, fds = {fd, ...}, paths = {s, ...}
+ *              [, seed = n]}
+ *   f:run(n)        execute n programs -> programs added to the corpus
+ *   f:stats()       {execs=, corpus=, edges=, kcov=}
+ *   f:program(i)    corpus entry i as {{nr, a1, ...}, ...}
+ * A program is a short sequence of calls from `calls`, arguments are
+ * generated from their prototypes (lktksyscalls.def) and issued with
+ * syscall() like sysCall does. Programs reaching edges not seen
+ * before are kept and mutated by later runs.
+ * Edges come from per-thread KCOV (/sys/kernel/debug/kcov); without
+ * it, the (previous call, call, result) triple stands for an edge,
+ * which still steers towards new error paths.
+ * Callers choose the calls: nothing here keeps the fuzzer from
+ * exiting or unmapping itself (see mutator.denied). f:run() notes
+ * the fds open when it starts (/proc/self/fd) and after each program
+ * closes only the ones the program opened, so the script's and
+ * lktk's own fds (kmsg, pool pipes, -R trace) survive.
+ */
+
+#define FUZZ_MT "lktk.fuzzer"
+
+#define FUZZ_PROG_CALLS 8       /* calls per program */
+#define FUZZ_CORPUS 4096        /* programs kept */
+#define FUZZ_COVER (64 << 10)   /* PCs per call in the KCOV buffer */
+#define FUZZ_EDGE_BITS 16       /* edge bitmap of 2^16 bits */
+#define FUZZ_BUFSIZE 4096
+#define FUZZ_MEM (1 << 20)      /* buf, obuf, ptr per position + slack */
+
+struct TFuzzCall {
+    int call; /* index into calls */
+    long val[LKTK_MAX_ARGS]; /* value, or index for fd/path/str */
+};
+typedef struct TFuzzCall FuzzCall;
+
+struct TFuzzProg {
+    int ncalls;
+    FuzzCall c[FUZZ_PROG_CALLS];
+};
+typedef struct TFuzzProg FuzzProg;
+
+struct TLktkFuzzer {
+    int ncalls;
+    int *nrs;
+    const LktkSyscallProto **protos;
+    int nfds;
+    long *fds;
+    unsigned char *keep;    /* fds open before the programs, by number */
+    int nkeep;              /* size of keep */
+    int top_fd;             /* highest fd in keep */
+    int npaths;
+    char **paths;
+    char *mem;
+    int kcov_fd;
+    unsigned long *cover;
+    unsigned char *edges;
+    FuzzProg *corpus;
+    int ncorpus;
+    LktkRng rng;
+    unsigned long execs;
+    unsigned long nedges;
+};
+typedef struct TLktkFuzzer LktkFuzzer;
+
+static const long ints[] = {0, 1, -1, 2, 3, 4, 8, 16, 64, 255, 256, 4096,
+    0x7fffffff, -0x80000000L};
+static const long lens[] = {0, 1, 8, 64, 512, FUZZ_BUFSIZE - 1,
+    FUZZ_BUFSIZE};
+static const long flag_bits[] = {1, 2, 4, 0x40, 0x80, 0x800};
+static const long modes[] = {0, 0644, 0755, 0777, 07777};
+static const long ids[] = {0, 65534, -1};
+static const long offs[] = {0, 1, 512, 4096, -1, 1L << 40};
+static const char *strs[] = {"", "lktk", "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"};
+
+#define countof(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+#define pick(f, n) ((int)(lktk_rand_next(&(f)->rng) % (uint64_t)(n)))
+
+static char *slot(LktkFuzzer *f, int kind, int pos) {
+    int s = (LKTK_ARG_BUF == kind) ? 0 : (LKTK_ARG_OBUF == kind) ? 1 : 2;
+    return f->mem + (size_t)(s * LKTK_MAX_ARGS + pos) * FUZZ_BUFSIZE;
+}
+
+static long gen_arg(LktkFuzzer *f, int kind) {
+    long v = 0;
+    int i;
+    switch (kind) {
+    case LKTK_ARG_INT:
+        return ints[pick(f, countof(ints))];
+    case LKTK_ARG_UINT:
+        return pick(f, 1025);
+    case LKTK_ARG_FD:
+        return f->nfds ? pick(f, f->nfds) : 0;
+    case LKTK_ARG_PATH:
+        return f->npaths ? pick(f, f->npaths) : 0;
+    case LKTK_ARG_STR:
+        return pick(f, countof(strs));
+    case LKTK_ARG_BUF:
+    case LKTK_ARG_OBUF:
+        return 1;
+    case LKTK_ARG_PTR:
+        return pick(f, 8) != 0;
+    case LKTK_ARG_LEN:
+        return lens[pick(f, countof(lens))];
+    case LKTK_ARG_FLAGS:
+        for (i = pick(f, 4); i > 0; i--) {
+            v |= flag_bits[pick(f, countof(flag_bits))];
+        }
+        return v;
+    case LKTK_ARG_MODE:
+        return modes[pick(f, countof(modes))];
+    case LKTK_ARG_PID:
+        return pick(f, 2) ? (long)getpid() : 0;
+    case LKTK_ARG_UID:
+    case LKTK_ARG_GID:
+        return ids[pick(f, countof(ids))];
+    case LKTK_ARG_SIG:
+    case LKTK_ARG_CMD:
+        return pick(f, 65);
+    case LKTK_ARG_ADDR:
+        return pick(f, 2);
+    case LKTK_ARG_OFF:
+        return offs[pick(f, countof(offs))];
+    default:
+        return 0;
+    }
+}
+
+/* argument as passed to the kernel */
+static long arg_value(LktkFuzzer *f, int kind, int pos, long v) {
+    char *p;
+    switch (kind) {
+    case LKTK_ARG_FD:
+        return f->nfds ? f->fds[v] : -1;
+    case LKTK_ARG_PATH:
+        return (long)(f->npaths ? f->paths[v] : "");
+    case LKTK_ARG_STR:
+        return (long)strs[v];
+    case LKTK_ARG_BUF:
+        return (long)slot(f, kind, pos);
+    case LKTK_ARG_OBUF:
+    case LKTK_ARG_PTR:
+        if (!v) {
+            return 0;
+        }
+        p = slot(f, kind, pos);
+        memset(p, 0, FUZZ_BUFSIZE);
+        return (long)p;
+    case LKTK_ARG_ADDR:
+        return v ? (long)f->mem : 0;
+    default:
+        return v;
+    }
+}
+
+static int has_kind(int kind) {
+    return kind && kind < LKTK_ARG_COUNT;
+}
+
+/* bytes a -R trace keeps for an argument of this kind */
+static size_t arg_len(int kind, long v) {
+    switch (kind) {
+    case LKTK_ARG_PATH:
+    case LKTK_ARG_STR:
+        return strlen((const char *)v) + 1;
+    case LKTK_ARG_BUF:
+    case LKTK_ARG_OBUF:
+    case LKTK_ARG_PTR:
+        return FUZZ_BUFSIZE;
+    default:
+        return 0;
+    }
+}
+
+static void gen_call(LktkFuzzer *f, FuzzCall *c) {
+    int i;
+    const LktkSyscallProto *p;
+    c->call = pick(f, f->ncalls);
+    p = f->protos[c->call];
+    for (i = 0; i < LKTK_MAX_ARGS; i++) {
+        c->val[i] = gen_arg(f, p ? p->args[i] : LKTK_ARG_INT);
+    }
+}
+
+static void gen_prog(LktkFuzzer *f, FuzzProg *prog) {
+    int i;
+    prog->ncalls = 1 + pick(f, FUZZ_PROG_CALLS / 2);
+    for (i = 0; i < prog->ncalls; i++) {
+        gen_call(f, &prog->c[i]);
+    }
+}
+
+static void mutate_prog(LktkFuzzer *f, FuzzProg *prog) {
+    FuzzCall *c = &prog->c[pick(f, prog->ncalls)];
+    const LktkSyscallProto *p = f->protos[c->call];
+    int nargs = p ? p->nargs : LKTK_MAX_ARGS;
+    int i, kind;
+    const FuzzProg *other;
+    switch (pick(f, 6)) {
+    case 0: /* new value for one argument */
+    case 1:
+        if (nargs > 0) {
+            i = pick(f, nargs);
+            c->val[i] = gen_arg(f, p ? p->args[i] : LKTK_ARG_INT);
+            break;
+        }
+        /* fall through */
+    case 2: /* replace a call */
+        gen_call(f, c);
+        break;
+    case 3: /* tweak a plain number */
+        i = nargs > 0 ? pick(f, nargs) : 0;
+        kind = p ? p->args[i] : LKTK_ARG_INT;
+        if (LKTK_ARG_INT == kind || LKTK_ARG_UINT == kind
+                || LKTK_ARG_FLAGS == kind || LKTK_ARG_CMD == kind
+                || LKTK_ARG_OFF == kind || LKTK_ARG_LEN == kind) {
+            if (pick(f, 2)) {
+                c->val[i] ^= 1L << pick(f, LKTK_ARG_LEN == kind ? 12 : 32);
+            } else {
+                c->val[i] += pick(f, 2) ? 1 : -1;
+            }
+            if (LKTK_ARG_LEN == kind) {
+                /* stays within the buffer it describes */
+                c->val[i] &= FUZZ_BUFSIZE - 1;
+            }
+        }
+        break;
+    case 4: /* insert or remove a call */
+        if (prog->ncalls < FUZZ_PROG_CALLS && pick(f, 2)) {
+            gen_call(f, &prog->c[prog->ncalls++]);
+        } else if (prog->ncalls > 1) {
+            prog->ncalls--;
+        }
+        break;
+    case 5: /* splice in calls of another program */
+        other = &f->corpus[pick(f, f->ncorpus)];
+        for (i = 0; prog->ncalls < FUZZ_PROG_CALLS && i < other->ncalls;
+                i++) {
+            if (pick(f, 2)) {
+                prog->c[prog->ncalls++] = other->c[i];
+            }
+        }
+        break;
+    }
+}
+
+static int add_edge(LktkFuzzer *f, uint64_t prev, uint64_t pc) {
+    uint64_t e = ((prev * 0x9E3779B97F4A7C15ULL) ^ pc)
+        * 0x9E3779B97F4A7C15ULL >> (64 - FUZZ_EDGE_BITS);
+    unsigned char bit = (unsigned char)(1 << (e & 7));
+    if (f->edges[e >> 3] & bit) {
+        return 0;
+    }
+    f->edges[e >> 3] |= bit;
+    f->nedges++;
+    return 1;
+}
+
+/* notes the open fds, so close_new_fds() leaves them alone */
+static int snapshot_fds(LktkFuzzer *f) {
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *de;
+    int fd, top = -1;
+    if (!dir) {
+        return -1;
+    }
+    if (f->keep) {
+        memset(f->keep, 0, (size_t)f->nkeep);
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if ('.' == de->d_name[0]) {
+            continue;
+        }
+        fd = atoi(de->d_name);
+        if (fd == dirfd(dir)) {
+            continue;
+        }
+        if (fd >= f->nkeep) {
+            unsigned char *keep = realloc(f->keep, (size_t)fd + 64);
+            if (!keep) {
+                closedir(dir);
+                return -1;
+            }
+            memset(keep + f->nkeep, 0, (size_t)(fd + 64 - f->nkeep));
+            f->keep = keep;
+            f->nkeep = fd + 64;
+        }
+        f->keep[fd] = 1;
+        if (fd > top) {
+            top = fd;
+        }
+    }
+    closedir(dir);
+    f->top_fd = top;
+    return 0;
+}
+
+/* closes the fds a program opened: above the snapshot, and in its holes */
+static void close_new_fds(LktkFuzzer *f) {
+    int fd;
+    for (fd = 0; fd < f->top_fd; fd++) {
+        if (!f->keep[fd] && fcntl(fd, F_GETFD) >= 0) {
+            close(fd);
+        }
+    }
+#ifdef SYS_close_range
+    syscall(SYS_close_range, f->top_fd + 1, ~0U, 0);
+#endif
+}
+
+/* runs prog -> number of new edges */
+static int exec_prog(LktkFuzzer *f, const FuzzProg *prog) {
+    long argz[LKTK_MAX_ARGS];
+    size_t lens[LKTK_MAX_ARGS];
+    LktkRecCall *rc;
+    long result;
+    int i, j, error, fresh = 0;
+    uint64_t prev = 0;
+    for (i = 0; i < prog->ncalls; i++) {
+        const FuzzCall *c = &prog->c[i];
+        const LktkSyscallProto *p = f->protos[c->call];
+        int nr = f->nrs[c->call];
+        for (j = 0; j < LKTK_MAX_ARGS; j++) {
+            int kind = p ? p->args[j] : LKTK_ARG_INT;
+            argz[j] = has_kind(kind) ? arg_value(f, kind, j, c->val[j]) : 0;
+            lens[j] = argz[j] ? arg_len(kind, argz[j]) : 0;
+        }
+        error = 0;
+        /* its writeback syscall stays out of the coverage */
+        rc = rec_syscall(nr, argz, lens);
+        if (f->cover) {
+            __atomic_store_n(&f->cover[0], 0, __ATOMIC_RELAXED);
+        }
+        result = syscall(nr, argz[0], argz[1], argz[2],
+                argz[3], argz[4], argz[5]);
+        if (-1 == result) {
+            error = errno;
+        }
+        rec_result(rc, result, error);
+        if (f->cover) {
+            unsigned long n = __atomic_load_n(&f->cover[0], __ATOMIC_RELAXED);
+            if (n >= FUZZ_COVER) {
+                n = FUZZ_COVER - 1;
+            }
+            prev = (uint64_t)nr;
+            for (j = 1; j <= (int)n; j++) {
+                fresh += add_edge(f, prev, f->cover[j]);
+                prev = f->cover[j];
+            }
+        } else {
+            uint64_t outcome = error ? (uint64_t)error << 1
+                : (result > 0) ? 1 : 0;
+            fresh += add_edge(f, prev, ((uint64_t)nr << 16) | outcome);
+            prev = ((uint64_t)nr << 16) | outcome;
+        }
+        log_syscall(nr, argz, result, error);
+        f->execs++;
+    }
+    close_new_fds(f);
+    return fresh;
+}
+
+static void kcov_open(LktkFuzzer *f) {
+    void *p;
+    f->kcov_fd = open("/sys/kernel/debug/kcov", O_RDWR | O_CLOEXEC);
+    if (f->kcov_fd < 0) {
+        log_info("fuzzer: no kcov (%s), using call results as edges",
+                strerror(errno));
+        return;
+    }
+    if (ioctl(f->kcov_fd, KCOV_INIT_TRACE, FUZZ_COVER)) {
+        goto fail;
+    }
+    p = mmap(NULL, FUZZ_COVER * sizeof(unsigned long),
+            PROT_READ | PROT_WRITE, MAP_SHARED, f->kcov_fd, 0);
+    if (MAP_FAILED == p) {
+        goto fail;
+    }
+    /* per thread: traces the thread creating the fuzzer */
+    if (ioctl(f->kcov_fd, KCOV_ENABLE, KCOV_TRACE_PC)) {
+        munmap(p, FUZZ_COVER * sizeof(unsigned long));
+        goto fail;
+    }
+    f->cover = (unsigned long *)p;
+    return;
+fail:
+    log_error("fuzzer: kcov setup failed: %s", strerror(errno));
+    close(f->kcov_fd);
+    f->kcov_fd = -1;
+}
+
+#define check_fuzzer(L) ((LktkFuzzer *)luaL_checkudata(L, 1, FUZZ_MT))
+
+static void fuzzer_free(LktkFuzzer *f) {
+    int i;
+    if (f->cover) {
+        ioctl(f->kcov_fd, KCOV_DISABLE, 0);
+        munmap(f->cover, FUZZ_COVER * sizeof(unsigned long));
+        f->cover = NULL;
+    }
+    if (f->kcov_fd >= 0) {
+        close(f->kcov_fd);
+        f->kcov_fd = -1;
+    }
+    if (f->mem) {
+        munmap(f->mem, FUZZ_MEM);
+        f->mem = NULL;
+    }
+    for (i = 0; f->paths && i < f->npaths; i++) {
+        free(f->paths[i]);
+    }
+    free(f->paths);
+    free(f->nrs);
+    free(f->protos);
+    free(f->fds);
+    free(f->keep);
+    free(f->edges);
+    free(f->corpus);
+    f->paths = NULL;
+    f->nrs = NULL;
+    f->protos = NULL;
+    f->fds = NULL;
+    f->keep = NULL;
+    f->edges = NULL;
+    f->corpus = NULL;
+}
+
+/* array field of the options table -> its length, values on stack */
+static int opt_array(lua_State *L, const char *key, int need) {
+    int n;
+    lua_getfield(L, 1, key);
+    if (lua_isnil(L, -1) && !need) {
+        return 0;
+    }
+    luaL_argcheck(L, lua_istable(L, -1), 1, key);
+    n = (int)luaL_len(L, -1);
+    luaL_argcheck(L, n > 0 || !need, 1, key);
+    return n;
+}
+
+// fuzzer{calls = {nr, ...}, fds = {...}, paths = {...} [, seed = n]}
+static int fuzzerNew(lua_State *L) {
+    LktkFuzzer *f;
+    int i;
+    luaL_checktype(L, 1, LUA_TTABLE);
+    f = (LktkFuzzer *)lua_newuserdata(L, sizeof(LktkFuzzer));
+    memset(f, 0, sizeof(LktkFuzzer));
+    f->kcov_fd = -1;
+    luaL_setmetatable(L, FUZZ_MT);
+
+    f->ncalls = opt_array(L, "calls", 1);
+    f->nrs = calloc((size_t)f->ncalls, sizeof(int));
+    f->protos = calloc((size_t)f->ncalls, sizeof(LktkSyscallProto *));
+    for (i = 0; f->nrs && f->protos && i < f->ncalls; i++) {
+        const char *name;
+        lua_rawgeti(L, -1, i + 1);
+        f->nrs[i] = (int)luaL_checkinteger(L, -1);
+        name = lktk_syscall_name(f->nrs[i]);
+        f->protos[i] = name ? lktk_syscall_proto(name) : NULL;
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    f->nfds = opt_array(L, "fds", 0);
+    f->fds = calloc((size_t)f->nfds + 1, sizeof(long));
+    for (i = 0; f->fds && i < f->nfds; i++) {
+        lua_rawgeti(L, -1, i + 1);
+        f->fds[i] = (long)luaL_checkinteger(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    f->npaths = opt_array(L, "paths", 0);
+    f->paths = calloc((size_t)f->npaths + 1, sizeof(char *));
+    for (i = 0; f->paths && i < f->npaths; i++) {
+        lua_rawgeti(L, -1, i + 1);
+        f->paths[i] = strdup(luaL_checkstring(L, -1));
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, 1, "seed");
+    /* without a seed: from the job stream, so -S replays it */
+    lktk_rand_seed(&f->rng, lua_isinteger(L, -1)
+            ? (uint64_t)lua_tointeger(L, -1) : lktk_rand());
+    lua_pop(L, 1);
+
+    f->edges = calloc(1, (1 << FUZZ_EDGE_BITS) / 8);
+    f->corpus = calloc(FUZZ_CORPUS, sizeof(FuzzProg));
+    f->mem = mmap(NULL, FUZZ_MEM, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == f->mem) {
+        f->mem = NULL;
+    }
+    if (!f->nrs || !f->protos || !f->fds || !f->paths || !f->edges
+            || !f->corpus || !f->mem) {
+        fuzzer_free(f);
+        return luaL_error(L, "fuzzer: out of memory");
+    }
+    /* input buffers: random bytes, set once */
+    lktk_rand_fill(&f->rng, f->mem, LKTK_MAX_ARGS * FUZZ_BUFSIZE);
+    kcov_open(f);
+    return 1;
+}
+
+// f:run(n) -> programs added to the corpus
+static int fuzzerRun(lua_State *L) {
+    LktkFuzzer *f = check_fuzzer(L);
+    lua_Integer n = luaL_checkinteger(L, 2);
+    lua_Integer added = 0;
+    FuzzProg prog;
+    luaL_argcheck(L, f->mem != NULL, 1, "fuzzer is closed");
+    if (snapshot_fds(f)) {
+        return luaL_error(L, "fuzzer: cannot list open fds: %s",
+                strerror(errno));
+    }
+    for (; n > 0; n--) {
+        if (!f->ncorpus || !pick(f, 16)) {
+            gen_prog(f, &prog);
+        } else {
+            int rounds = 1 + pick(f, 3);
+            prog = f->corpus[pick(f, f->ncorpus)];
+            while (rounds--) {
+                mutate_prog(f, &prog);
+            }
+        }
+        if (exec_prog(f, &prog)) {
+            if (f->ncorpus < FUZZ_CORPUS) {
+                f->corpus[f->ncorpus++] = prog;
+            } else {
+                f->corpus[pick(f, FUZZ_CORPUS)] = prog;
+            }
+            added++;
+        }
+    }
+    lua_pushinteger(L, added);
+    return 1;
+}
+
+static int fuzzerStats(lua_State *L) {
+    LktkFuzzer *f = check_fuzzer(L);
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, (lua_Integer)f->execs);
+    lua_setfield(L, -2, "execs");
+    lua_pushinteger(L, f->ncorpus);
+    lua_setfield(L, -2, "corpus");
+    lua_pushinteger(L, (lua_Integer)f->nedges);
+    lua_setfield(L, -2, "edges");
+    lua_pushboolean(L, f->cover != NULL);
+    lua_setfield(L, -2, "kcov");
+    return 1;
+}
+
+// f:program(i) -> {{nr, a1, ...}, ...} with the values passed last
+static int fuzzerProgram(lua_State *L) {
+    LktkFuzzer *f = check_fuzzer(L);
+    lua_Integer idx = luaL_checkinteger(L, 2);
+    const FuzzProg *prog;
+    int i, j;
+    luaL_argcheck(L, f->mem && idx >= 1 && idx <= f->ncorpus, 2,
+            "no such program");
+    prog = &f->corpus[idx - 1];
+    lua_createtable(L, prog->ncalls, 0);
+    for (i = 0; i < prog->ncalls; i++) {
+        const FuzzCall *c = &prog->c[i];
+        const LktkSyscallProto *p = f->protos[c->call];
+        int nargs = p ? p->nargs : LKTK_MAX_ARGS;
+        lua_createtable(L, nargs + 1, 0);
+        lua_pushinteger(L, f->nrs[c->call]);
+        lua_rawseti(L, -2, 1);
+        for (j = 0; j < nargs; j++) {
+            int kind = p ? p->args[j] : LKTK_ARG_INT;
+            if (LKTK_ARG_PATH == kind && f->npaths) {
+                lua_pushstring(L, f->paths[c->val[j]]);
+            } else if (LKTK_ARG_STR == kind) {
+                lua_pushstring(L, strs[c->val[j]]);
+            } else if (LKTK_ARG_FD == kind) {
+                lua_pushinteger(L, f->nfds ? f->fds[c->val[j]] : -1);
+            } else if (LKTK_ARG_ADDR == kind) {
+                lua_pushinteger(L, c->val[j] ? (lua_Integer)f->mem : 0);
+            } else if (LKTK_ARG_BUF == kind || LKTK_ARG_OBUF == kind
+                    || LKTK_ARG_PTR == kind) {
+                /* address of the fuzzer's own buffer */
+                lua_pushinteger(L, c->val[j]
+                        ? (lua_Integer)slot(f, kind, j) : 0);
+            } else {
+                lua_pushinteger(L, c->val[j]);
+            }
+            lua_rawseti(L, -2, j + 2);
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static int fuzzerGc(lua_State *L) {
+    fuzzer_free(check_fuzzer(L));
+    return 0;
+}
+
+static const struct luaL_Reg fuzzer_methods[] = {
+    {"run", fuzzerRun},
+    {"stats", fuzzerStats},
+    {"program", fuzzerProgram},
+    {"close", fuzzerGc},
+    {"__gc", fuzzerGc},
+    {NULL, NULL}
+};
+
+void inject_lktkfuzz(lua_State *L) {
+    luaL_newmetatable(L, FUZZ_MT);
+    luaL_setfuncs(L, fuzzer_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+    lua_register(L, "fuzzer", fuzzerNew);
+}
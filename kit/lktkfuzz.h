@@ -0,0 +1,8 @@
+#ifndef LKTKFUZZ_H
+#define LKTKFUZZ_H
+
+#include "lktklib.h"
+
+void inject_lktkfuzz(lua_State *L);
+
+#endif
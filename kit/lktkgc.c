@@ -0,0 +1,137 @@
+#include "lktkgc.h"
+#include "lstate.h"
+
+/*
+ * Collector control for scripts
+ *   gc.policy("iteration")
+ *   gc.policy("step" [, n])
+ *   gc.policy("inc" [, pause [, stepmul]])
+ *   gc.stats()   {policy, ns, steps, full} of the running job
+ */
+
+static const char *const policy_names[] = {"inc", "iteration", "step", NULL};
+
+LktkGcPolicy lktk_gc_default = {LKTK_GC_INC, LKTK_GC_PAUSE, LKTK_GC_STEPMUL, 1};
+LktkGcPolicy lktk_gc;
+LktkGcStats lktk_gc_last;
+
+/* counters when the job began */
+static LktkGcStats job_start;
+
+static void gc_counters(lua_State *L, LktkGcStats *st) {
+    global_State *g = G(L);
+    st->ns = g->gcclock;
+    st->steps = g->gcsteps;
+    st->full = g->gcfull;
+}
+
+static void gc_apply(lua_State *L, const LktkGcPolicy *p) {
+    lktk_gc = *p;
+    if (LKTK_GC_INC == p->kind) {
+        lua_gc(L, LUA_GCSETPAUSE, p->pause);
+        lua_gc(L, LUA_GCSETSTEPMUL, p->stepmul);
+        lua_gc(L, LUA_GCRESTART, 0);
+    } else {
+        lua_gc(L, LUA_GCSTOP, 0);
+    }
+}
+
+int lktk_gc_parse(const char *s, LktkGcPolicy *p) {
+    LktkGcPolicy np = lktk_gc_default;
+    size_t len = strcspn(s, ":");
+    int i;
+    for (i = 0; policy_names[i]; i++) {
+        if (strlen(policy_names[i]) == len && !strncmp(s, policy_names[i], len)) {
+            break;
+        }
+    }
+    if (!policy_names[i]) {
+        return -1;
+    }
+    np.kind = i;
+    s += len;
+    switch (np.kind) {
+    case LKTK_GC_INC:
+        np.pause = LKTK_GC_PAUSE;
+        np.stepmul = LKTK_GC_STEPMUL;
+        if (*s && sscanf(s, ":%d:%d", &np.pause, &np.stepmul) < 1) {
+            return -1;
+        }
+        break;
+    case LKTK_GC_STEP:
+        if (*s && (sscanf(s, ":%d", &np.budget) != 1 || np.budget < 1)) {
+            return -1;
+        }
+        break;
+    default:
+        if (*s) {
+            return -1;
+        }
+    }
+    *p = np;
+    return 0;
+}
+
+void lktk_gc_begin(lua_State *L) {
+    gc_apply(L, &lktk_gc_default);
+    gc_counters(L, &job_start);
+}
+
+void lktk_gc_end(lua_State *L, int collect) {
+    LktkGcStats now;
+    if (collect && LKTK_GC_INC != lktk_gc.kind) {
+        lua_gc(L, LUA_GCCOLLECT, 0); /* between jobs: nobody is timed */
+    }
+    gc_counters(L, &now);
+    lktk_gc_last.ns = now.ns - job_start.ns;
+    lktk_gc_last.steps = now.steps - job_start.steps;
+    lktk_gc_last.full = now.full - job_start.full;
+    gc_apply(L, &lktk_gc_default);
+    lua_gc(L, LUA_GCRESTART, 0); /* REPL, idle workers */
+}
+
+// gc.policy(name [, a [, b]])
+static int gcPolicy(lua_State *L) {
+    LktkGcPolicy p = lktk_gc_default;
+    p.kind = luaL_checkoption(L, 1, NULL, policy_names);
+    switch (p.kind) {
+    case LKTK_GC_INC:
+        p.pause = (int)luaL_optinteger(L, 2, LKTK_GC_PAUSE);
+        p.stepmul = (int)luaL_optinteger(L, 3, LKTK_GC_STEPMUL);
+        break;
+    case LKTK_GC_STEP:
+        p.budget = (int)luaL_optinteger(L, 2, lktk_gc_default.budget);
+        luaL_argcheck(L, p.budget > 0, 2, "at least one step");
+        break;
+    }
+    gc_apply(L, &p);
+    return 0;
+}
+
+static int gcStats(lua_State *L) {
+    LktkGcStats now;
+    gc_counters(L, &now);
+    lua_createtable(L, 0, 4);
+    lua_pushstring(L, policy_names[lktk_gc.kind]);
+    lua_setfield(L, -2, "policy");
+    lua_pushinteger(L, (lua_Integer)(now.ns - job_start.ns));
+    lua_setfield(L, -2, "ns");
+    lua_pushinteger(L, (lua_Integer)(now.steps - job_start.steps));
+    lua_setfield(L, -2, "steps");
+    lua_pushinteger(L, (lua_Integer)(now.full - job_start.full));
+    lua_setfield(L, -2, "full");
+    return 1;
+}
+
+static const struct luaL_Reg gc_funcs[] = {
+    {"policy", gcPolicy},
+    {"stats", gcStats},
+    {NULL, NULL}
+};
+
+void inject_lktkgc(lua_State *L) {
+    lktk_gc = lktk_gc_default;
+    gc_counters(L, &job_start);
+    luaL_newlib(L, gc_funcs);
+    lua_setglobal(L, "gc");
+}
@@ -0,0 +1,66 @@
+#ifndef LKTKGC_H
+#define LKTKGC_H
+
+#include "lktklib.h"
+
+/*
+ * Collector policies (-G, gc.policy in scripts)
+ *   inc[:pause[:stepmul]]   Lua's incremental collector (default 200:200)
+ *   iteration               no collection while a job runs, a full one
+ *                           after it: the script is not interrupted
+ *   step[:n]                no automatic steps, n basic steps (Lua's
+ *                           fixed unit of work, default 1) after each
+ *                           syscall
+ * A policy set by a script lasts until its job ends. GC time comes
+ * from the counters lgc.c keeps in global_State.
+ */
+
+#define LKTK_GC_INC 0
+#define LKTK_GC_ITERATION 1
+#define LKTK_GC_STEP 2
+
+/* Lua's own pacing (lstate.c) */
+#define LKTK_GC_PAUSE 200
+#define LKTK_GC_STEPMUL 200
+
+struct TLktkGcPolicy {
+    int kind;
+    int pause;   /* inc */
+    int stepmul; /* inc */
+    int budget;  /* step: basic steps per syscall */
+};
+typedef struct TLktkGcPolicy LktkGcPolicy;
+
+/* collector use of one job */
+struct TLktkGcStats {
+    unsigned long long ns;
+    unsigned long long steps;
+    unsigned long long full;
+};
+typedef struct TLktkGcStats LktkGcStats;
+
+/* -G, for every job */
+extern LktkGcPolicy lktk_gc_default;
+/* policy of the running job */
+extern LktkGcPolicy lktk_gc;
+/* of the last job that ended */
+extern LktkGcStats lktk_gc_last;
+
+/* "step:4" -> policy; 0 or -1 */
+int lktk_gc_parse(const char *s, LktkGcPolicy *p);
+void lktk_gc_begin(lua_State *L);
+/* collect: the state lives on (not a child of -F) */
+void lktk_gc_end(lua_State *L, int collect);
+
+static inline void lktk_gc_syscall(lua_State *L) {
+    int i;
+    if (LKTK_GC_STEP == lktk_gc.kind) {
+        for (i = 0; i < lktk_gc.budget; i++) {
+            lua_gc(L, LUA_GCSTEP, 0);
+        }
+    }
+}
+
+void inject_lktkgc(lua_State *L);
+
+#endif
@@ -0,0 +1,221 @@
+#define _GNU_SOURCE /* memmem */
+
+#include "lktkkmsg.h"
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
+
+#include "dmesg.h"
+
+/*
+ * Kernel log watcher
+ * Keeps /dev/kmsg open (positioned at the end when opened), so each
+ * drain reads and parses only records that appeared since the last
+ * one; no re-reading of the whole ring buffer.
+ * Records looking like a kernel error are counted and attributed
+ * to the current label (script and iteration being run).
+ * Serial runs use a watcher thread; the pool supervisor polls
+ * kmsg_watch_fd() in its own event loop instead (no threads around
+ * fork()).
+ */
+
+static const char *kmsg_error_patterns[] = {
+    "WARNING:",
+    "BUG:",
+    "Oops",
+    "kernel BUG at",
+    "general protection fault",
+    "Kernel panic",
+    "UBSAN:",
+    "KASAN:",
+    "INFO: task",
+    "watchdog:",
+    "rcu_sched detected stall",
+    NULL
+};
+
+static struct {
+    int fd;
+    int stop_fd;
+    unsigned errors;
+    unsigned long long seq;
+    char label[128];
+    kmsg_attrib_fn attrib;
+    void *attrib_data;
+    char buf[BUFSIZ];
+    pthread_t thread;
+    int running;
+} kw = { .fd = -1, .stop_fd = -1 };
+
+static pthread_mutex_t kw_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int is_kernel_error(const struct kmsg_line *line) {
+    const char **pat;
+    for (pat = kmsg_error_patterns; *pat; pat++) {
+        if (memmem(line->mesg, line->mesg_size, *pat, strlen(*pat))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int kmsg_watch_open(void) {
+    if (kw.fd >= 0) {
+        return kw.fd;
+    }
+    kw.fd = open("/dev/kmsg", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (kw.fd < 0) {
+        log_info("cannot open /dev/kmsg: %s", strerror(errno));
+        return -1;
+    }
+    /* only messages from now on are of interest */
+    lseek(kw.fd, 0, SEEK_END);
+    return kw.fd;
+}
+
+/* forked child: drop our copy without reading from it */
+void kmsg_watch_forget(void) {
+    if (kw.fd >= 0) {
+        close(kw.fd);
+        kw.fd = -1;
+    }
+    kw.running = 0;
+}
+
+int kmsg_watch_fd(void) {
+    return kw.fd;
+}
+
+/* must be called with kw_lock held */
+static int drain_locked(void) {
+    struct kmsg_line line;
+    ssize_t sz;
+    int found = 0;
+    if (kw.fd < 0) {
+        return 0;
+    }
+    for (;;) {
+        sz = read(kw.fd, kw.buf, sizeof(kw.buf) - 1);
+        if (sz < 0) {
+            if (EPIPE == errno) {
+                /* ring wrapped over unread records; cursor moves on */
+                continue;
+            }
+            break; /* EAGAIN: nothing new */
+        }
+        if (0 == sz) {
+            break;
+        }
+        kw.buf[sz] = '\0';
+        if (parse_kmsg_line(kw.buf, (size_t)sz, &line)) {
+            continue;
+        }
+        if (kw.seq && line.seq > kw.seq + 1) {
+            log_info("kmsg: %llu records lost", line.seq - kw.seq - 1);
+        }
+        kw.seq = line.seq;
+        if (is_kernel_error(&line)) {
+            char label[sizeof(kw.label)];
+            if (kw.attrib) {
+                label[0] = '\0';
+                kw.attrib(kw.attrib_data, &line.tv, label, sizeof(label));
+            } else {
+                memcpy(label, kw.label, sizeof(label));
+            }
+            kw.errors++;
+            found++;
+            log_error("kernel: %.*s [during %s]",
+                    (int)line.mesg_size, line.mesg,
+                    label[0] ? label : "-");
+        }
+    }
+    return found;
+}
+
+int kmsg_watch_drain(void) {
+    int found;
+    pthread_mutex_lock(&kw_lock);
+    found = drain_locked();
+    pthread_mutex_unlock(&kw_lock);
+    return found;
+}
+
+void kmsg_watch_label(const char *fmt, ...) {
+    va_list ap;
+    pthread_mutex_lock(&kw_lock);
+    /* whatever came before belongs to the previous label */
+    drain_locked();
+    va_start(ap, fmt);
+    vsnprintf(kw.label, sizeof(kw.label), fmt, ap);
+    va_end(ap);
+    pthread_mutex_unlock(&kw_lock);
+}
+
+void kmsg_watch_attrib(kmsg_attrib_fn fn, void *data) {
+    pthread_mutex_lock(&kw_lock);
+    drain_locked();
+    kw.attrib = fn;
+    kw.attrib_data = data;
+    pthread_mutex_unlock(&kw_lock);
+}
+
+unsigned kmsg_watch_errors(void) {
+    unsigned errors;
+    pthread_mutex_lock(&kw_lock);
+    drain_locked();
+    errors = kw.errors;
+    pthread_mutex_unlock(&kw_lock);
+    return errors;
+}
+
+static void *watch_thread(void *arg) {
+    struct pollfd fds[2] = {
+        { .fd = kw.fd, .events = POLLIN },
+        { .fd = kw.stop_fd, .events = POLLIN },
+    };
+    (void)arg;
+    while (poll(fds, 2, -1) >= 0 || EINTR == errno) {
+        if (fds[1].revents) {
+            break;
+        }
+        if (fds[0].revents) {
+            kmsg_watch_drain();
+        }
+    }
+    return NULL;
+}
+
+int kmsg_watch_start(void) {
+    if (kw.running) {
+        return 0;
+    }
+    if (kmsg_watch_open() < 0) {
+        return -1;
+    }
+    kw.stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (kw.stop_fd < 0) {
+        return -1;
+    }
+    if (pthread_create(&kw.thread, NULL, watch_thread, NULL)) {
+        close(kw.stop_fd);
+        kw.stop_fd = -1;
+        return -1;
+    }
+    kw.running = 1;
+    return 0;
+}
+
+void kmsg_watch_stop(void) {
+    uint64_t one = 1;
+    if (!kw.running) {
+        return;
+    }
+    if (write(kw.stop_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(kw.thread, NULL);
+    }
+    close(kw.stop_fd);
+    kw.stop_fd = -1;
+    kw.running = 0;
+    kmsg_watch_drain();
+}
@@ -0,0 +1,21 @@
+#ifndef LKTKKMSG_H
+#define LKTKKMSG_H
+
+#include "lktklib.h"
+#include <sys/time.h>
+
+int kmsg_watch_open(void);
+int kmsg_watch_fd(void);
+void kmsg_watch_forget(void);
+int kmsg_watch_drain(void);
+int kmsg_watch_start(void);
+void kmsg_watch_stop(void);
+void kmsg_watch_label(const char *fmt, ...);
+
+/* names what was running at 'when' (kernel timestamp) */
+typedef void (*kmsg_attrib_fn)(void *data, const struct timeval *when,
+        char *label, size_t size);
+void kmsg_watch_attrib(kmsg_attrib_fn fn, void *data);
+unsigned kmsg_watch_errors(void);
+
+#endif
@@ -1,7 +1,16 @@
 #include "lktklib.h"
+#include "lktklog.h"
+#include "lktkkmsg.h"
+#include "lktkstruct.h"
+#include "lktkbuf.h"
+#include "lktkrand.h"
+#include "lktkrec.h"
+#include "lktkgc.h"
 #include <stdio.h>
 #include <stdarg.h>
 
+LktkInfo kit;
+
 int isRoot(lua_State *L) {
     uid_t uid = getuid();
     if (0 == uid) {
@@ -20,147 +29,11 @@ int isRoot(lua_State *L) {
 /*
  * Data structures with 'visible' fileds
  * i.e. wrappers for access each field by name
- * Other (not 'implemented') data types
- * could be provided as string.pack-ed blobs
- * (TODO: Could they?)
+ * are described in lktkstruct.def (see lktkstruct.c)
  */
 
-//////// SHED_ATTR ///////////////////////
-
 #include "sched/types.h"
 
-// lua table --> struct *sched_attr
-static void* unmarshall_sched_attr(lua_State *L, int idx) {
-    if (lua_type(L, idx) != LUA_TTABLE) {
-        log_error("sched_attr got no table!");
-        return 0;
-    }
-	struct sched_attr *sa =
-	        (struct sched_attr *)lua_newuserdata(L, sizeof(struct sched_attr));
-    lua_setfield(L, idx, "__userdata");
-    sa->size = sizeof(struct sched_attr);
-    if (LUA_TNUMBER == lua_getfield(L, idx, "size")) {
-        sa->size = (__u32)lua_tointeger(L, -1);
-    }
-    // TODO: what would be pushed in case of no such attr?
-    lua_getfield(L, idx, "sched_policy");
-    sa->sched_policy = (__u32)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "sched_flags");
-    sa->sched_flags = (__u64)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "sched_nice");
-    sa->sched_nice = (__s32)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "sched_priority");
-    sa->sched_priority = (__u32)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "sched_runtime");
-    sa->sched_runtime = (__u64)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "sched_deadline");
-    sa->sched_deadline = (__u64)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "sched_period");
-    sa->sched_period = (__u64)lua_tointeger(L, -1);
-    lua_pop(L,8);
-    return (void*)sa;
-}
-
-// struct sched_attr --> lua table
-static void marshall_sched_attr(lua_State *L, int idx) {
-    lua_getfield(L, idx, "__userdata");
-    struct sched_attr *a = 
-        (struct sched_attr*)lua_touserdata(L, -1);
-    lua_pop(L, 2);
-    lua_pushinteger(L, a->size);
-    lua_setfield(L, idx, "size");
-    lua_pushinteger(L, a->sched_policy);
-    lua_setfield(L, idx, "sched_policy");
-    lua_pushinteger(L, a->sched_flags);
-    lua_setfield(L, idx, "sched_flags");
-    lua_pushinteger(L, a->sched_nice);
-    lua_setfield(L, idx, "sched_nice");
-    lua_pushinteger(L, a->sched_priority);
-    lua_setfield(L, idx, "sched_priority");
-    lua_pushinteger(L, a->sched_runtime);
-    lua_setfield(L, idx, "sched_runtime");
-    lua_pushinteger(L, a->sched_deadline);
-    lua_setfield(L, idx, "sched_deadline");
-    lua_pushinteger(L, a->sched_period);
-    lua_setfield(L, idx, "sched_period");
-}
-
-//////// FLOCK ///////////////////////////
-
-// lua table --> struct *flock
-static void* unmarshall_flock(lua_State *L, int idx) {
-    if (lua_type(L, idx) != LUA_TTABLE) {
-        log_error("flock got no table!");
-        return 0;
-    }
-	struct flock* lock =
-        (struct flock*)lua_newuserdata(L, sizeof(struct flock));
-    lua_setfield(L, idx, "__userdata");
-    lua_getfield(L, idx, "l_type");
-    lock->l_type = (short)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "l_whence");
-    lock->l_whence = (short)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "l_start");
-    lock->l_start = (off_t)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "l_len");
-    lock->l_len = (off_t)lua_tointeger(L, -1);
-    lua_getfield(L, idx, "l_pid");
-    lock->l_pid = (pid_t)lua_tointeger(L, -1);
-    lua_pop(L, 5);
-    return (void*)lock;
-}
-
-// struct flock --> lua table
-static void marshall_flock(lua_State *L, int idx) {
-    lua_getfield(L, idx, "__userdata");
-    if (lua_type(L, -1) != LUA_TUSERDATA) {
-        log_error("flock userdata!");
-    }
-    struct flock *l = 
-        (struct flock*)lua_touserdata(L, -1);
-    lua_pop(L, 1);
-    lua_pushinteger(L, l->l_type);
-    lua_setfield(L, idx, "l_type");
-    lua_pushinteger(L, l->l_whence);
-    lua_setfield(L, idx, "l_whence");
-    lua_pushinteger(L, l->l_start);
-    lua_setfield(L, idx, "l_start");
-    lua_pushinteger(L, l->l_len);
-    lua_setfield(L, idx, "l_len");
-    lua_pushinteger(L, l->l_pid);
-    lua_setfield(L, idx, "l_pid");
-}
-
-//////// STAT ////////////////////////////
-
-static void marshall_stat(lua_State *L, int idx) {
-    lua_getfield(L, idx, "__userdata");
-    struct stat *s = (struct stat*)lua_touserdata(L, -1);
-    lua_pop(L, 2);
-    lua_pushinteger(L, s->st_dev);
-    lua_setfield(L, idx, "st_dev");
-    lua_pushinteger(L, s->st_ino);
-    lua_setfield(L, idx, "st_ino");
-    lua_pushinteger(L, s->st_mode);        /* file type and mode */
-    lua_setfield(L, idx, "st_mode");
-    lua_pushinteger(L, s->st_nlink);       /* number of hard links */
-    lua_setfield(L, idx, "st_nlink");
-    lua_pushinteger(L, s->st_uid);         /* user ID of owner */
-    lua_setfield(L, idx, "st_uid");
-    lua_pushinteger(L, s->st_gid);         /* group ID of owner */
-    lua_setfield(L, idx, "st_gid");
-    lua_pushinteger(L, s->st_rdev);        /* device ID (if special file) */
-    lua_setfield(L, idx, "st_rdev");
-    lua_pushinteger(L, s->st_size);        /* total size, in bytes */
-    lua_setfield(L, idx, "st_size");
-    lua_pushinteger(L, s->st_blksize);     /* blocksize for filesystem I/O */
-    lua_setfield(L, idx, "st_blksize");
-    lua_pushinteger(L, s->st_blocks);      /* number of 512B blocks allocated */
-    lua_setfield(L, idx, "st_blocks");
-}
-
-// .. end of boring stuff
-
 /*** helpers from posix lib ***/
 
 static int argtypeerror(lua_State *L, int narg, const char *expected) {
@@ -234,66 +107,85 @@ static int posixWait(lua_State *L) {
 
 static int posixFork(lua_State *L) {
 	//checknargs(L, 0);
-	lua_pushinteger(L, fork());
+	uint64_t child = lktk_rand_fork();
+	pid_t pid = fork();
+	if (0 == pid) {
+	    kmsg_watch_forget(); /* parent keeps watching */
+	    trace_forget();
+	    lktk_rand_forked(child);
+	    rec_forked();
+	}
+	lua_pushinteger(L, pid);
     return 1;
 }
 
 //////////////////////////
 
-static long unmarshall(lua_State *L, int idx) {
-    void *ud;
-	lua_getfield(L, idx, "__type");
-	// TODO: check type
-	int datatype = lua_tointeger(L, -1);
-	lua_pop(L, 1);
-	// TODO: ??? probably usefull feature
-	// to provide __SIZE for creating unstructured blobs
-
-	// TODO: if __userdata already set - just return it???
-
-	switch(datatype) {
-	case LKTK_stat:
-		ud = lua_newuserdata(L, sizeof(struct stat));
-		/* no setting fields: output only struct */
-	    lua_setfield(L, idx, "__userdata");
-		break;
-    case LKTK_flock:
-        ud = unmarshall_flock(L, idx);
-        break;
-	case LKTK_sched_attr:
-        ud = unmarshall_sched_attr(L, idx);
-	    break;
-	default:
-		ud = 0;
-		break;
-	}
-	return (long)ud;
-}
+/*
+ * Argument shape cache.
+ * Each struct table passed to syscall gets one userdata buffer
+ * (LktkShape header + C struct), created on first use and kept in
+ * a weak-keyed registry table: struct table -> userdata.
+ * Repeated calls with the same table find the buffer with one
+ * pointer-keyed lookup: no '__type' lookup, no new userdata.
+ * NOTE: struct type of a table is fixed at its first syscall.
+ */
+static char shape_cache_key;
 
-static void marshall(lua_State *L, int idx) {
+LktkShape *get_shape(lua_State *L, int idx) {
+    LktkShape *shape;
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &shape_cache_key);
+    lua_pushvalue(L, idx);
+    if (LUA_TUSERDATA == lua_rawget(L, -2)) {
+        shape = (LktkShape *)lua_touserdata(L, -1);
+        lua_pop(L, 2);
+        return shape;
+    }
+    lua_pop(L, 1);
+    /* miss: resolve type once */
     lua_getfield(L, idx, "__type");
+    // TODO: check type
     int datatype = lua_tointeger(L, -1);
     lua_pop(L, 1);
-    switch(datatype) {
-    case LKTK_stat:
-        marshall_stat(L, idx);
-        break;
-    case LKTK_flock:
-        marshall_flock(L, idx);
-        break;
-    case LKTK_sched_attr:
-        marshall_sched_attr(L, idx);
-        break;
-    default:
-        break;
+    const LktkStruct *st = lktk_struct(datatype);
+    if (!st) {
+        lua_pop(L, 1);
+        return NULL;
+    }
+    size_t size = st->size;
+    shape = (LktkShape *)lua_newuserdata(L, LKTK_SHAPE_HDR + size);
+    shape->datatype = datatype;
+    shape->size = size;
+    memset(shape_payload(shape), 0, size);
+    lua_pushvalue(L, idx);
+    lua_insert(L, -2);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+    return shape;
+}
+
+static void *unmarshall(lua_State *L, int idx, LktkShape *shape) {
+    void *ud = shape_payload(shape);
+    const LktkStruct *st = lktk_struct(shape->datatype);
+    if (st->dir & LKTK_DIR_IN) {
+        lktk_struct_pack(L, idx, st, ud);
+    }
+    return ud;
+}
+
+void marshall(lua_State *L, int idx, LktkShape *shape) {
+    const LktkStruct *st = lktk_struct(shape->datatype);
+    if (st->dir & LKTK_DIR_OUT) {
+        lktk_struct_unpack(L, idx, st, shape_payload(shape));
     }
 }
 
 /*
  * Converts any type to long
  * (or long pointer to void)
+ * Struct tables leave their shape in *shape
  */
-static long any_to_long(lua_State* L, int idx, int *table_flag) {
+long any_to_long(lua_State* L, int idx, LktkShape **shape) {
     switch (lua_type(L, idx)) {
 	case LUA_TBOOLEAN:
 		return (long)lua_toboolean(L, idx);
@@ -302,10 +194,13 @@ static long any_to_long(lua_State* L, int idx, int *table_flag) {
 	case LUA_TSTRING:
 		return (long)lua_tostring(L, idx);
 	case LUA_TUSERDATA:
-		return (long)lua_touserdata(L, idx);
+		return (long)lktk_userdata_ptr(L, idx);
 	case LUA_TTABLE:
-		*table_flag = 1;
-		return unmarshall(L, idx);
+		*shape = get_shape(L, idx);
+		if (!*shape) {
+		    return 0;
+		}
+		return (long)unmarshall(L, idx, *shape);
 	case LUA_TLIGHTUSERDATA:
 	case LUA_TFUNCTION:
 	case LUA_TTHREAD:
@@ -319,55 +214,199 @@ static long any_to_long(lua_State* L, int idx, int *table_flag) {
     }
 }
 
+/*
+ * Errno names
+ * Each one is a global (EBADF == 9) and errno_name[9] == "EBADF",
+ * both set once at startup, so scripts can branch on errors
+ * returned by syscall without formatting strings.
+ */
+#define LKTK_ERRNO(_e) {#_e, _e},
+static const struct {
+    const char *name;
+    int value;
+} errno_names[] = {
+    LKTK_ERRNO(EPERM) LKTK_ERRNO(ENOENT) LKTK_ERRNO(ESRCH) LKTK_ERRNO(EINTR)
+    LKTK_ERRNO(EIO) LKTK_ERRNO(ENXIO) LKTK_ERRNO(E2BIG) LKTK_ERRNO(ENOEXEC)
+    LKTK_ERRNO(EBADF) LKTK_ERRNO(ECHILD) LKTK_ERRNO(EAGAIN)
+    LKTK_ERRNO(ENOMEM) LKTK_ERRNO(EACCES) LKTK_ERRNO(EFAULT)
+    LKTK_ERRNO(ENOTBLK) LKTK_ERRNO(EBUSY) LKTK_ERRNO(EEXIST)
+    LKTK_ERRNO(EXDEV) LKTK_ERRNO(ENODEV) LKTK_ERRNO(ENOTDIR)
+    LKTK_ERRNO(EISDIR) LKTK_ERRNO(EINVAL) LKTK_ERRNO(ENFILE)
+    LKTK_ERRNO(EMFILE) LKTK_ERRNO(ENOTTY) LKTK_ERRNO(ETXTBSY)
+    LKTK_ERRNO(EFBIG) LKTK_ERRNO(ENOSPC) LKTK_ERRNO(ESPIPE) LKTK_ERRNO(EROFS)
+    LKTK_ERRNO(EMLINK) LKTK_ERRNO(EPIPE) LKTK_ERRNO(EDOM) LKTK_ERRNO(ERANGE)
+    LKTK_ERRNO(EDEADLK) LKTK_ERRNO(ENAMETOOLONG) LKTK_ERRNO(ENOLCK)
+    LKTK_ERRNO(ENOSYS) LKTK_ERRNO(ENOTEMPTY) LKTK_ERRNO(ELOOP)
+    LKTK_ERRNO(ENOMSG) LKTK_ERRNO(EIDRM) LKTK_ERRNO(ECHRNG)
+    LKTK_ERRNO(EL2NSYNC) LKTK_ERRNO(EL3HLT) LKTK_ERRNO(EL3RST)
+    LKTK_ERRNO(ELNRNG) LKTK_ERRNO(EUNATCH) LKTK_ERRNO(ENOCSI)
+    LKTK_ERRNO(EL2HLT) LKTK_ERRNO(EBADE) LKTK_ERRNO(EBADR) LKTK_ERRNO(EXFULL)
+    LKTK_ERRNO(ENOANO) LKTK_ERRNO(EBADRQC) LKTK_ERRNO(EBADSLT)
+    LKTK_ERRNO(EBFONT) LKTK_ERRNO(ENOSTR) LKTK_ERRNO(ENODATA)
+    LKTK_ERRNO(ETIME) LKTK_ERRNO(ENOSR) LKTK_ERRNO(ENONET) LKTK_ERRNO(ENOPKG)
+    LKTK_ERRNO(EREMOTE) LKTK_ERRNO(ENOLINK) LKTK_ERRNO(EADV)
+    LKTK_ERRNO(ESRMNT) LKTK_ERRNO(ECOMM) LKTK_ERRNO(EPROTO)
+    LKTK_ERRNO(EMULTIHOP) LKTK_ERRNO(EDOTDOT) LKTK_ERRNO(EBADMSG)
+    LKTK_ERRNO(EOVERFLOW) LKTK_ERRNO(ENOTUNIQ) LKTK_ERRNO(EBADFD)
+    LKTK_ERRNO(EREMCHG) LKTK_ERRNO(ELIBACC) LKTK_ERRNO(ELIBBAD)
+    LKTK_ERRNO(ELIBSCN) LKTK_ERRNO(ELIBMAX) LKTK_ERRNO(ELIBEXEC)
+    LKTK_ERRNO(EILSEQ) LKTK_ERRNO(ERESTART) LKTK_ERRNO(ESTRPIPE)
+    LKTK_ERRNO(EUSERS) LKTK_ERRNO(ENOTSOCK) LKTK_ERRNO(EDESTADDRREQ)
+    LKTK_ERRNO(EMSGSIZE) LKTK_ERRNO(EPROTOTYPE) LKTK_ERRNO(ENOPROTOOPT)
+    LKTK_ERRNO(EPROTONOSUPPORT) LKTK_ERRNO(ESOCKTNOSUPPORT)
+    LKTK_ERRNO(EOPNOTSUPP) LKTK_ERRNO(EPFNOSUPPORT) LKTK_ERRNO(EAFNOSUPPORT)
+    LKTK_ERRNO(EADDRINUSE) LKTK_ERRNO(EADDRNOTAVAIL) LKTK_ERRNO(ENETDOWN)
+    LKTK_ERRNO(ENETUNREACH) LKTK_ERRNO(ENETRESET) LKTK_ERRNO(ECONNABORTED)
+    LKTK_ERRNO(ECONNRESET) LKTK_ERRNO(ENOBUFS) LKTK_ERRNO(EISCONN)
+    LKTK_ERRNO(ENOTCONN) LKTK_ERRNO(ESHUTDOWN) LKTK_ERRNO(ETOOMANYREFS)
+    LKTK_ERRNO(ETIMEDOUT) LKTK_ERRNO(ECONNREFUSED) LKTK_ERRNO(EHOSTDOWN)
+    LKTK_ERRNO(EHOSTUNREACH) LKTK_ERRNO(EALREADY) LKTK_ERRNO(EINPROGRESS)
+    LKTK_ERRNO(ESTALE) LKTK_ERRNO(EUCLEAN) LKTK_ERRNO(ENOTNAM)
+    LKTK_ERRNO(ENAVAIL) LKTK_ERRNO(EISNAM) LKTK_ERRNO(EREMOTEIO)
+    LKTK_ERRNO(EDQUOT) LKTK_ERRNO(ENOMEDIUM) LKTK_ERRNO(EMEDIUMTYPE)
+    LKTK_ERRNO(ECANCELED) LKTK_ERRNO(ENOKEY) LKTK_ERRNO(EKEYEXPIRED)
+    LKTK_ERRNO(EKEYREVOKED) LKTK_ERRNO(EKEYREJECTED) LKTK_ERRNO(EOWNERDEAD)
+    LKTK_ERRNO(ENOTRECOVERABLE) LKTK_ERRNO(ERFKILL) LKTK_ERRNO(EHWPOISON)
+    {NULL, 0}
+};
+#undef LKTK_ERRNO
+
 /*
  * This is main procedure in this module
  * Calling sys by number
  * Parameters are just 'blindly' converted to long
  * That is probably OK for 64-bit linux calling conv.
+ * Returns (result, errno), errno is 0 on success.
  */
-// TODO: return (syscall ret, error)
 static int sysCall(lua_State *L) {
     long result = -1; 
-    long argz[6];
-    int arg_typez[6];
+    int error = 0;
+    long argz[LKTK_MAX_ARGS] = {0};
+    LktkShape *shapez[LKTK_MAX_ARGS] = {0};
+    LktkRecCall *rc;
 	int i;
-	int table_flag;
-    int arg_cnt = lua_gettop(L);
-	if (arg_cnt < 1) {
-		// TODO: handle error
-        goto end;
-	}
+    int arg_cnt = lua_gettop(L) - 1;
+	luaL_argcheck(L, arg_cnt <= LKTK_MAX_ARGS, LKTK_MAX_ARGS + 2,
+	        "too many arguments to syscall");
 	int syscall_nr = luaL_checkinteger(L, 1);
 	if (syscall_nr < 0) {
-		// TODO: handle error
+	    /* what the kernel would say */
+	    error = ENOSYS;
         goto end;
     }
-	for (i=2; i<=arg_cnt; i++) {
-		// TODO: save types: arg_typez[]
-		table_flag = 0;
-		argz[i-2] = any_to_long(L, i, &table_flag);
-		arg_typez[i-2] = table_flag;
+	for (i=0; i<arg_cnt; i++) {
+		argz[i] = any_to_long(L, i+2, &shapez[i]);
 	}
-	// TODO: write only used args ; parse types
-	/* log before call */
-    log_info("syscall #%d (0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx)",
-        syscall_nr,
-        argz[0], argz[1], argz[2],
-        argz[3], argz[4], argz[5]);
+    /* with -R: in the trace (page cache) before the kernel sees it */
+    rc = rec_call(L, 2, syscall_nr, argz, shapez, arg_cnt);
 	// do the main stuff:
     result = syscall(syscall_nr,
 		argz[0], argz[1], argz[2],
 		argz[3], argz[4], argz[5]);
+    /* before marshalling: Lua allocations may change errno */
+    if (-1 == result) {
+        error = errno;
+    }
+    rec_result(rc, result, error);
+    /* recorded in binary, formatted lazily */
+    log_syscall(syscall_nr, argz, result, error);
 
-	// TODO: parse struct args back
-    for (i=0; i<=arg_cnt-2; i++) {
-    	if (arg_typez[i]) {
-    		marshall(L, i+2);// set i+2 param on the lua stack
+    for (i=0; i<arg_cnt; i++) {
+    	if (shapez[i]) {
+    		marshall(L, i+2, shapez[i]);// set i+2 param on the lua stack
     	}
     }
+    /* -G step: collector work between syscalls only */
+    lktk_gc_syscall(L);
 end:
     lua_pushinteger(L, result);
-    return 1;
+    lua_pushinteger(L, error);
+    return 2;
+}
+
+/*
+ * Batched syscalls:
+ *   res, err = syscall_batch({{nr, a1, ...}, {nr, ...}, ...} [, times])
+ * All arguments are converted once, then the whole vector is issued
+ * back-to-back 'times' times (default 1) with no Lua in between.
+ * Returns arrays of results and errno values (0 on success)
+ * of the last round; struct args are marshalled back at the end.
+ */
+struct TLktkBatchCall {
+    int nr;
+    int arg_cnt;
+    long result;
+    int error;
+    long argz[LKTK_MAX_ARGS];
+    LktkShape *shapez[LKTK_MAX_ARGS];
+    size_t lens[LKTK_MAX_ARGS]; /* recorded with -R */
+};
+typedef struct TLktkBatchCall LktkBatchCall;
+
+static int sysCallBatch(lua_State *L) {
+    int i, j, n;
+    long rep;
+    LktkBatchCall *calls;
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_Integer times = luaL_optinteger(L, 2, 1);
+    luaL_argcheck(L, times > 0, 2, "positive number expected");
+    n = (int)luaL_len(L, 1);
+    calls = (LktkBatchCall *)lua_newuserdata(L,
+            (n ? n : 1) * sizeof(LktkBatchCall));
+    memset(calls, 0, (n ? n : 1) * sizeof(LktkBatchCall));
+    for (i = 0; i < n; i++) {
+        LktkBatchCall *c = &calls[i];
+        if (LUA_TTABLE != lua_rawgeti(L, 1, i+1)) {
+            return luaL_error(L, "syscall_batch: entry %d is not a table", i+1);
+        }
+        c->arg_cnt = (int)luaL_len(L, -1) - 1;
+        if (c->arg_cnt < 0 || c->arg_cnt > LKTK_MAX_ARGS) {
+            return luaL_error(L, "syscall_batch: entry %d has %d arguments",
+                    i+1, c->arg_cnt);
+        }
+        lua_rawgeti(L, -1, 1);
+        c->nr = (int)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        for (j = 0; j < c->arg_cnt; j++) {
+            lua_rawgeti(L, -1, j+2);
+            /* strings and struct buffers stay anchored by the entry */
+            c->argz[j] = any_to_long(L, lua_absindex(L, -1), &c->shapez[j]);
+            c->lens[j] = rec_payload_len(L, -1, c->shapez[j]);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+    for (rep = 0; rep < times; rep++) {
+        for (i = 0; i < n; i++) {
+            LktkBatchCall *c = &calls[i];
+            LktkRecCall *rc = rec_syscall(c->nr, c->argz, c->lens);
+            c->result = syscall(c->nr,
+                c->argz[0], c->argz[1], c->argz[2],
+                c->argz[3], c->argz[4], c->argz[5]);
+            c->error = (-1 == c->result) ? errno : 0;
+            rec_result(rc, c->result, c->error);
+            log_syscall(c->nr, c->argz, c->result, c->error);
+        }
+    }
+    lua_createtable(L, n, 0);
+    lua_createtable(L, n, 0);
+    for (i = 0; i < n; i++) {
+        LktkBatchCall *c = &calls[i];
+        lua_pushinteger(L, c->result);
+        lua_rawseti(L, -3, i+1);
+        lua_pushinteger(L, c->error);
+        lua_rawseti(L, -2, i+1);
+        for (j = 0; j < c->arg_cnt; j++) {
+            if (c->shapez[j]) {
+                lua_rawgeti(L, 1, i+1);
+                lua_rawgeti(L, -1, j+2);
+                marshall(L, lua_absindex(L, -1), c->shapez[j]);
+                lua_pop(L, 2);
+            }
+        }
+    }
+    lktk_gc_syscall(L);
+    return 2;
 }
 
 static int sizeof_sched_attr(lua_State *L) {
@@ -382,10 +421,19 @@ const struct luaL_Reg lktklib_globals[] = {
     {"wait", posixWait},
     {"sleep", posixSleep},
     {"syscall", sysCall},
+    {"syscall_batch", sysCallBatch},
     {NULL, NULL}
 };
 
 void inject_lktklib(lua_State* L) {
+    /* weak-keyed cache: struct table -> shape userdata */
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &shape_cache_key);
+
     lua_pushglobaltable(L);
     luaL_setfuncs(L, lktklib_globals, 0);
 	LPOSIX_CONST( FD_CLOEXEC	);
@@ -416,6 +464,7 @@ void inject_lktklib(lua_State* L) {
 	LPOSIX_CONST( O_SYNC		);
 	LPOSIX_CONST( O_TRUNC		);
 	LPOSIX_CONST( O_CLOEXEC		);
+	LPOSIX_CONST( AT_FDCWD		);
     /* ??? */
 	LPOSIX_CONST( S_IFMT		);
 	LPOSIX_CONST( S_IFBLK		);
@@ -440,17 +489,15 @@ void inject_lktklib(lua_State* L) {
 	LPOSIX_CONST( S_ISGID		);
 	LPOSIX_CONST( S_ISUID		);
 	/* datatype handles */
-    LKTK_DATATYPE(stat);
-    LKTK_DATATYPE(timespec);
-    LKTK_DATATYPE(timeval);
-    LKTK_DATATYPE(sockaddr);
-    LKTK_DATATYPE(rlimit);
-    LKTK_DATATYPE(perf_event_attr);
-    LKTK_DATATYPE(sched_param);
-    LKTK_DATATYPE(sched_attr);
-    LKTK_DATATYPE(file_handle);
-    LKTK_DATATYPE(epoll_event);
-    LKTK_DATATYPE(flock);
-    // TODO: more...
+    lktk_struct_handles(L);
+    /* errno values and names */
+    lua_createtable(L, 134, 0);
+    for (int i = 0; errno_names[i].name; i++) {
+        lua_pushinteger(L, errno_names[i].value);
+        lua_setfield(L, -3, errno_names[i].name);
+        lua_pushstring(L, errno_names[i].name);
+        lua_rawseti(L, -2, errno_names[i].value);
+    }
+    lua_setfield(L, -2, "errno_name");
     lua_pop(L, 1);
 }
@@ -23,14 +23,17 @@
 
 #include <syslog.h>
 
-// TODO: get rid of it:
+/* set by build: BUILD=debug (1) or BUILD=release (0) */
+#ifndef DEBUG
 #define DEBUG 1
+#endif
 
 struct TLktkInfo {
     int failures;
     int parallel;
     int iterations;
     int timeout;
+    unsigned long long seed; /* of all random streams, -S */
     char syslog;
     char strict;
     char verbose;
@@ -38,69 +41,53 @@ struct TLktkInfo {
 };
 typedef struct TLktkInfo LktkInfo;
 
-LktkInfo kit;
+extern LktkInfo kit;
 
 void inject_lktklib(lua_State* L);
 
-#define LKTK_stat 1
-#define LKTK_timespec 2
-#define LKTK_timeval 3
-#define LKTK_sockaddr 4
-#define LKTK_rlimit 5
-#define LKTK_perf_event_attr 6
-#define LKTK_sched_param 7
-#define LKTK_sched_attr 8
-#define LKTK_file_handle 9
-#define LKTK_epoll_event 10
-#define LKTK_flock 11
-
-//#define LKTK_iattr;
-//#define LKTK_inode;
-//#define LKTK_iocb;
-//#define LKTK_io_event;
-//#define LKTK_iovec;
-//#define LKTK_itimerspec;
-//#define LKTK_itimerval;
-//#define LKTK_kexec_segment;
-//#define LKTK_linux_dirent;
-//#define LKTK_linux_dirent64;
-//#define LKTK_list_head;
-//#define LKTK_mmap_arg_struct;
-//#define LKTK_msgbuf;
-//#define LKTK_user_msghdr;
-//#define LKTK_mmsghdr;
-//#define LKTK_msqid_ds;
-//#define LKTK_new_utsname;
-//#define LKTK_nfsctl_arg;
-//#define LKTK___old_kernel_stat;
-//#define LKTK_oldold_utsname;
-//#define LKTK_old_utsname;
-//#define LKTK_pollfd;
-//#define LKTK_rlimit64;
-//#define LKTK_rusage;
-//#define LKTK_sel_arg_struct;
-//#define LKTK_semaphore;
-//#define LKTK_sembuf;
-//#define LKTK_shmid_ds;
-//#define LKTK_stat;
-//#define LKTK_stat64;
-//#define LKTK_statfs;
-//#define LKTK_statfs64;
-//#define LKTK_statx;
-//#define LKTK___sysctl_args;
-//#define LKTK_sysinfo;
-//#define LKTK_timex;
-//#define LKTK_timezone;
-//#define LKTK_tms;
-//#define LKTK_utimbuf;
-//#define LKTK_mq_attr;
-//#define LKTK_compat_stat;
-//#define LKTK_compat_timeval;
-//#define LKTK_robust_list_head;
-//#define LKTK_getcpu_cache;
-//#define LKTK_old_linux_dirent;
-//#define LKTK_sigaltstack;
-//#define LKTK_bpf_attr;
+#define LKTK_MAX_ARGS 6
+
+/* header of userdata buffer backing a struct argument */
+struct TLktkShape {
+    int datatype;
+    size_t size;
+};
+typedef struct TLktkShape LktkShape;
+
+#define LKTK_SHAPE_HDR ((sizeof(LktkShape) + 15) & ~(size_t)15)
+#define shape_payload(s) ((void*)((char*)(s) + LKTK_SHAPE_HDR))
+
+/* struct table <-> C struct conversion (lktklib.c) */
+LktkShape *get_shape(lua_State *L, int idx);
+void marshall(lua_State *L, int idx, LktkShape *shape);
+long any_to_long(lua_State* L, int idx, LktkShape **shape);
+
+/* struct datatype handles: LKTK_stat, LKTK_flock, ... */
+#define LKTK_STRUCT(name, ctype, dir) LKTK_##name,
+#define LKTK_FIELD(name, field)
+#define LKTK_FIELD_AS(name, key, path)
+#define LKTK_SIZE(name, field)
+#define LKTK_PTR(name, field)
+#define LKTK_PTR_AS(name, key, path)
+#define LKTK_STR(name, field)
+#define LKTK_BYTES(name, field)
+#define LKTK_RAW(name, key, off, size)
+#define LKTK_END(name)
+enum {
+    LKTK_none,
+#include "lktkstruct.def"
+    LKTK_DATATYPES
+};
+#undef LKTK_STRUCT
+#undef LKTK_FIELD
+#undef LKTK_FIELD_AS
+#undef LKTK_SIZE
+#undef LKTK_PTR
+#undef LKTK_PTR_AS
+#undef LKTK_STR
+#undef LKTK_BYTES
+#undef LKTK_RAW
+#undef LKTK_END
 
 #define echo(x,...) do{\
         printf("\x1b[0;%s;1m", #x);\
@@ -119,13 +106,18 @@ void inject_lktklib(lua_State* L);
 #define DBG(...)
 #endif
 
+/* formats pending syscall trace records (lktklog.c) */
+void trace_flush(void);
+
 #define log_error(...)\
-    do{echo_error(__VA_ARGS__);\
+    do{trace_flush();\
+        echo_error(__VA_ARGS__);\
         if(kit.syslog){syslog(LOG_ERR, __VA_ARGS__);}\
     }while(0);
 
 #define log_info(...)\
     do{if(kit.verbose){\
+        trace_flush();\
         echo_info(__VA_ARGS__);\
         if(kit.syslog){syslog(LOG_INFO, __VA_ARGS__);}\
     }}while(0);
@@ -134,8 +126,4 @@ void inject_lktklib(lua_State* L);
     lua_pushinteger(L, _f);\
     lua_setfield(L, -2, #_f);}while(0)
 
-#define LKTK_DATATYPE(x) do{\
-    lua_pushinteger(L,LKTK_##x);\
-    lua_setfield(L,-2,#x);}while(0)
-
 #endif
@@ -0,0 +1,106 @@
+#include "lktklog.h"
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Single writer (the thread running the script) bumps 'head' after
+ * filling a slot; readers take records between 'tail' and 'head'.
+ * The writer never waits, so it may lap the reader: records it has
+ * overwritten are reported as dropped, both before printing and for
+ * a slot that was overwritten while it was being copied.
+ * Flushing may come from the kmsg watcher thread too; flushers take
+ * 'lock' in turn, so a message is never printed ahead of the trace
+ * lines recorded before it.
+ */
+struct TLktkTraceRec {
+    struct timespec when;
+    long nr;
+    long argz[LKTK_MAX_ARGS];
+    long result;
+    int error;
+};
+typedef struct TLktkTraceRec LktkTraceRec;
+
+static struct {
+    LktkTraceRec ring[LKTK_TRACE_SLOTS];
+    uint64_t head;
+    uint64_t tail;
+    pthread_mutex_t lock;
+} trace = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+void trace_syscall(long nr, const long *argz, long result, int error) {
+    uint64_t head = __atomic_load_n(&trace.head, __ATOMIC_RELAXED);
+    LktkTraceRec *r = &trace.ring[head & (LKTK_TRACE_SLOTS - 1)];
+    clock_gettime(CLOCK_MONOTONIC, &r->when);
+    r->nr = nr;
+    memcpy(r->argz, argz, sizeof(r->argz));
+    r->result = result;
+    r->error = error;
+    __atomic_store_n(&trace.head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void trace_print(const LktkTraceRec *r) {
+#define TRACE_FMT "[%ld.%06ld] syscall #%ld (0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx, 0x%lx) = %ld"
+#define TRACE_ARGS (long)r->when.tv_sec, r->when.tv_nsec / 1000, r->nr,\
+        r->argz[0], r->argz[1], r->argz[2], r->argz[3], r->argz[4], r->argz[5],\
+        r->result
+    if (r->error) {
+        echo_info(TRACE_FMT " (%s)", TRACE_ARGS, strerror(r->error));
+        if (kit.syslog) {
+            syslog(LOG_INFO, TRACE_FMT " (%s)", TRACE_ARGS, strerror(r->error));
+        }
+    } else {
+        echo_info(TRACE_FMT, TRACE_ARGS);
+        if (kit.syslog) {
+            syslog(LOG_INFO, TRACE_FMT, TRACE_ARGS);
+        }
+    }
+#undef TRACE_FMT
+#undef TRACE_ARGS
+}
+
+static void trace_dropped(uint64_t n) {
+    if (n) {
+        echo_warn("... %lu syscall records dropped", (unsigned long)n);
+    }
+}
+
+void trace_flush(void) {
+    LktkTraceRec r;
+    uint64_t head, tail, dropped = 0;
+    if (__atomic_load_n(&trace.head, __ATOMIC_ACQUIRE)
+            == __atomic_load_n(&trace.tail, __ATOMIC_RELAXED)) {
+        return; /* nothing pending: the common case */
+    }
+    pthread_mutex_lock(&trace.lock);
+    head = __atomic_load_n(&trace.head, __ATOMIC_ACQUIRE);
+    tail = trace.tail;
+    /* the oldest slot is the one the writer fills next */
+    if (head - tail > LKTK_TRACE_SLOTS - 1) {
+        dropped = head - tail - (LKTK_TRACE_SLOTS - 1);
+        tail = head - (LKTK_TRACE_SLOTS - 1);
+    }
+    for (; tail != head; tail++) {
+        r = trace.ring[tail & (LKTK_TRACE_SLOTS - 1)];
+        /* the writer may have reused the slot while we copied it */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&trace.head, __ATOMIC_RELAXED) - tail
+                >= LKTK_TRACE_SLOTS) {
+            dropped++;
+            continue;
+        }
+        trace_dropped(dropped);
+        dropped = 0;
+        trace_print(&r);
+    }
+    trace_dropped(dropped);
+    __atomic_store_n(&trace.tail, tail, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&trace.lock);
+}
+
+/* forked child: the parent owns (and flushes) what was recorded so far */
+void trace_forget(void) {
+    /* the watcher thread did not come along, nor does its hold on lock */
+    pthread_mutex_init(&trace.lock, NULL);
+    trace.tail = trace.head;
+}
@@ -0,0 +1,33 @@
+#ifndef LKTKLOG_H
+#define LKTKLOG_H
+
+#include "lktklib.h"
+
+/*
+ * Per-syscall trace
+ * Calls are recorded in binary form into a per-process ring buffer
+ * and formatted only on trace_flush(), which log_info/log_error do
+ * before printing (so the order of output is kept), and at the end
+ * of each script run.
+ * Build with -DLKTK_TRACE=0 to drop tracing entirely; by default it
+ * follows DEBUG.
+ */
+#ifndef LKTK_TRACE
+#define LKTK_TRACE DEBUG
+#endif
+
+#define LKTK_TRACE_SLOTS 4096 /* power of 2 */
+
+void trace_syscall(long nr, const long *argz, long result, int error);
+void trace_forget(void);
+/* trace_flush() is declared in lktklib.h for the log macros */
+
+#if LKTK_TRACE
+#define log_syscall(nr, argz, result, error) do{\
+    if(kit.verbose){trace_syscall((nr), (argz), (result), (error));}\
+    }while(0)
+#else
+#define log_syscall(nr, argz, result, error)
+#endif
+
+#endif
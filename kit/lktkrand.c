@@ -0,0 +1,238 @@
+#include "lktkrand.h"
+#include "lktkbuf.h"
+
+/*
+ * Random numbers for scripts
+ *   rng.seed()                 the run seed (print it, replay with -S)
+ *   rng.random([m [, n]])      as math.random, from the job stream
+ *   rng.bytes(n)               string of n random bytes
+ *   rng.fill(buffer [, off [, len]])   arena buffer, in place
+ *   s = rng.stream(id)         independent stream id of this job,
+ *                              with s:random(...), s:bytes(n), s:fill(b)
+ * math.random and math.randomseed are replaced: scripts using them
+ * are reproducible too, randomseed(x) restarts the job stream at x.
+ */
+
+#define RNG_MT "lktk.rng"
+
+LktkRng lktk_rng;
+
+static uint64_t forks;
+/* which child of which child... of the job this process is */
+static uint64_t lineage;
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void lktk_rand_seed(LktkRng *r, uint64_t seed) {
+    int i;
+    for (i = 0; i < 4; i++) {
+        r->s[i] = splitmix64(&seed);
+    }
+}
+
+void lktk_rand_fill(LktkRng *r, void *p, size_t len) {
+    unsigned char *c = (unsigned char *)p;
+    uint64_t x;
+    for (; len >= sizeof(x); len -= sizeof(x), c += sizeof(x)) {
+        x = lktk_rand_next(r);
+        memcpy(c, &x, sizeof(x));
+    }
+    if (len) {
+        x = lktk_rand_next(r);
+        memcpy(c, &x, len);
+    }
+}
+
+uint64_t lktk_rand_entropy(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec)
+        ^ ((uint64_t)getpid() << 40);
+}
+
+static void stream_seed(LktkRng *r, int script, int iteration, uint64_t id) {
+    uint64_t x = kit.seed;
+    uint64_t seed = splitmix64(&x);
+    x ^= ((uint64_t)(unsigned)script << 32) | (unsigned)iteration;
+    seed ^= splitmix64(&x);
+    x ^= id;
+    seed ^= splitmix64(&x);
+    lktk_rand_seed(r, seed);
+}
+
+static int cur_script = -1, cur_iteration = -1;
+
+void lktk_rand_job(int script, int iteration) {
+    cur_script = script;
+    cur_iteration = iteration;
+    forks = lineage = 0;
+    stream_seed(&lktk_rng, script, iteration, 0);
+}
+
+uint64_t lktk_rand_fork(void) {
+    uint64_t x = lineage ^ ++forks;
+    return splitmix64(&x);
+}
+
+void lktk_rand_forked(uint64_t child) {
+    lineage = child;
+    forks = 0;
+    /* top bit apart from rng.stream ids */
+    stream_seed(&lktk_rng, cur_script, cur_iteration, lineage | (1ULL << 63));
+}
+
+/* Lua 5.3 math.random semantics over any stream */
+static int push_random(lua_State *L, LktkRng *r, int first) {
+    uint64_t rv = lktk_rand_next(r);
+    lua_Integer low, up;
+    uint64_t range;
+    switch (lua_gettop(L) - first + 1) {
+    case 0:
+        lua_pushnumber(L, (lua_Number)(rv >> 11) * (0.5 / ((uint64_t)1 << 52)));
+        return 1;
+    case 1:
+        low = 1;
+        up = luaL_checkinteger(L, first);
+        break;
+    case 2:
+        low = luaL_checkinteger(L, first);
+        up = luaL_checkinteger(L, first + 1);
+        break;
+    default:
+        return luaL_error(L, "wrong number of arguments");
+    }
+    luaL_argcheck(L, low <= up, first, "interval is empty");
+    range = (uint64_t)up - (uint64_t)low;
+    if (range != ~0ULL) {
+        /* unbiased: draw below the next power of 2, retry above range */
+        uint64_t lim = range | (range >> 1);
+        lim |= lim >> 2;
+        lim |= lim >> 4;
+        lim |= lim >> 8;
+        lim |= lim >> 16;
+        lim |= lim >> 32;
+        while ((rv &= lim) > range) {
+            rv = lktk_rand_next(r);
+        }
+    }
+    lua_pushinteger(L, (lua_Integer)(rv + (uint64_t)low));
+    return 1;
+}
+
+static int push_bytes(lua_State *L, LktkRng *r, int idx) {
+    lua_Integer n = luaL_checkinteger(L, idx);
+    luaL_Buffer b;
+    luaL_argcheck(L, n >= 0, idx, "negative size");
+    lktk_rand_fill(r, luaL_buffinitsize(L, &b, (size_t)n), (size_t)n);
+    luaL_pushresultsize(&b, (size_t)n);
+    return 1;
+}
+
+static int fill_buffer(lua_State *L, LktkRng *r, int idx) {
+    size_t len = lktk_userdata_len(L, idx);
+    char *p = (char *)lktk_userdata_ptr(L, idx);
+    lua_Integer off = luaL_optinteger(L, idx + 1, 0);
+    lua_Integer n = luaL_optinteger(L, idx + 2, (lua_Integer)len - off);
+    luaL_argcheck(L, off >= 0 && (size_t)off <= len, idx + 1,
+            "offset out of buffer");
+    luaL_argcheck(L, n >= 0 && (size_t)n <= len - (size_t)off, idx + 2,
+            "length out of buffer");
+    lktk_rand_fill(r, p + off, (size_t)n);
+    return 0;
+}
+
+static int rngRandom(lua_State *L) {
+    return push_random(L, &lktk_rng, 1);
+}
+
+/* any number seeds: integers as they are, floats by their bits */
+static int rngRandomseed(lua_State *L) {
+    lua_Number n = luaL_checknumber(L, 1);
+    uint64_t seed = 0;
+    if (lua_isinteger(L, 1)) {
+        seed = (uint64_t)lua_tointeger(L, 1);
+    } else {
+        memcpy(&seed, &n, sizeof(seed) < sizeof(n) ? sizeof(seed) : sizeof(n));
+    }
+    lktk_rand_seed(&lktk_rng, seed);
+    return 0;
+}
+
+static int rngSeed(lua_State *L) {
+    lua_pushinteger(L, (lua_Integer)kit.seed);
+    return 1;
+}
+
+static int rngBytes(lua_State *L) {
+    return push_bytes(L, &lktk_rng, 1);
+}
+
+static int rngFill(lua_State *L) {
+    return fill_buffer(L, &lktk_rng, 1);
+}
+
+// rng.stream(id) -> stream
+static int rngStream(lua_State *L) {
+    uint64_t id = (uint64_t)luaL_checkinteger(L, 1);
+    LktkRng *r = (LktkRng *)lua_newuserdata(L, sizeof(LktkRng));
+    luaL_setmetatable(L, RNG_MT);
+    /* id 0 is the job stream itself */
+    stream_seed(r, cur_script, cur_iteration, id + 1);
+    return 1;
+}
+
+#define check_stream(L) ((LktkRng *)luaL_checkudata(L, 1, RNG_MT))
+
+static int streamRandom(lua_State *L) {
+    return push_random(L, check_stream(L), 2);
+}
+
+static int streamBytes(lua_State *L) {
+    return push_bytes(L, check_stream(L), 2);
+}
+
+static int streamFill(lua_State *L) {
+    return fill_buffer(L, check_stream(L), 2);
+}
+
+static const struct luaL_Reg rng_funcs[] = {
+    {"seed", rngSeed},
+    {"random", rngRandom},
+    {"bytes", rngBytes},
+    {"fill", rngFill},
+    {"stream", rngStream},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg stream_methods[] = {
+    {"random", streamRandom},
+    {"bytes", streamBytes},
+    {"fill", streamFill},
+    {NULL, NULL}
+};
+
+void inject_lktkrand(lua_State *L) {
+    lktk_rand_job(-1, -1); /* REPL, -e, -l */
+    luaL_newmetatable(L, RNG_MT);
+    luaL_setfuncs(L, stream_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newlib(L, rng_funcs);
+    lua_setglobal(L, "rng");
+
+    lua_getglobal(L, "math");
+    if (lua_istable(L, -1)) {
+        lua_pushcfunction(L, rngRandom);
+        lua_setfield(L, -2, "random");
+        lua_pushcfunction(L, rngRandomseed);
+        lua_setfield(L, -2, "randomseed");
+    }
+    lua_pop(L, 1);
+}
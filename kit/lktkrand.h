@@ -0,0 +1,54 @@
+#ifndef LKTKRAND_H
+#define LKTKRAND_H
+
+#include "lktklib.h"
+#include <stdint.h>
+
+/*
+ * Random numbers: xoshiro256** streams
+ * Every job (script, iteration) gets its own stream derived from the
+ * run seed (kit.seed, -S), so a run replays with the same -S no matter
+ * which worker picks a job up. Forked children switch to a stream of
+ * their own, derived from their place in the fork tree.
+ */
+struct TLktkRng {
+    uint64_t s[4];
+};
+typedef struct TLktkRng LktkRng;
+
+/* stream of the current job */
+extern LktkRng lktk_rng;
+
+void lktk_rand_seed(LktkRng *r, uint64_t seed);
+void lktk_rand_fill(LktkRng *r, void *p, size_t len);
+/* seed for a run without -S */
+uint64_t lktk_rand_entropy(void);
+/* switch lktk_rng to the stream of the job */
+void lktk_rand_job(int script, int iteration);
+/* in the parent, before fork(): lineage of the next child */
+uint64_t lktk_rand_fork(void);
+/* in the forked child: leave the parent's stream for the child's own */
+void lktk_rand_forked(uint64_t child);
+
+static inline uint64_t lktk_rand_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t lktk_rand_next(LktkRng *r) {
+    uint64_t *s = r->s;
+    uint64_t result = lktk_rand_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = lktk_rand_rotl(s[3], 45);
+    return result;
+}
+
+#define lktk_rand() lktk_rand_next(&lktk_rng)
+
+void inject_lktkrand(lua_State *L);
+
+#endif
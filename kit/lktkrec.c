@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include "lktkrec.h"
+#include "lktkbuf.h"
+#include "lktksyscalls.h"
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <linux/io_uring.h>
+
+#define REC_CHUNK (1 << 20)      /* file grows by doubling from here */
+#define REC_WRITEBACK (64 << 10) /* start writeback every 64k */
+
+#define pad8(n) (((n) + 7) & ~(size_t)7)
+
+const char *lktk_rec_dir;
+
+static struct {
+    int fd;
+    char *base;
+    size_t size;
+    size_t used;
+    size_t synced;
+    int iteration;
+    char script[224];
+    char path[PATH_MAX];
+} rec = {.fd = -1};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void rec_close(void) {
+    if (rec.base) {
+        munmap(rec.base, rec.size);
+        rec.base = NULL;
+    }
+    if (rec.fd >= 0) {
+        close(rec.fd);
+        rec.fd = -1;
+    }
+}
+
+void rec_begin(const char *script, int iteration) {
+    LktkRecHeader *h;
+    struct utsname u;
+    const char *name;
+    if (!lktk_rec_dir) {
+        return;
+    }
+    name = strrchr(script, '/');
+    name = name ? name + 1 : script;
+    snprintf(rec.path, sizeof(rec.path), "%s/%s.%d.%d.trace",
+            lktk_rec_dir, name, iteration, (int)getpid());
+    snprintf(rec.script, sizeof(rec.script), "%s", script);
+    rec.iteration = iteration;
+    rec.fd = open(rec.path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (rec.fd < 0 || ftruncate(rec.fd, REC_CHUNK)) {
+        log_error("trace: cannot create %s: %s", rec.path, strerror(errno));
+        rec_close();
+        return;
+    }
+    rec.base = mmap(NULL, REC_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED,
+            rec.fd, 0);
+    if (MAP_FAILED == rec.base) {
+        rec.base = NULL;
+        log_error("trace: cannot map %s: %s", rec.path, strerror(errno));
+        rec_close();
+        unlink(rec.path);
+        return;
+    }
+    rec.size = REC_CHUNK;
+    h = (LktkRecHeader *)rec.base;
+    memcpy(h->magic, LKTK_REC_MAGIC, sizeof(h->magic));
+    if (!uname(&u)) {
+        size_t n = strlen(u.machine);
+        memcpy(h->arch, u.machine, n < sizeof(h->arch) ? n : sizeof(h->arch) - 1);
+    }
+    h->seed = kit.seed;
+    h->iteration = iteration;
+    h->pid = (int32_t)getpid();
+    snprintf(h->script, sizeof(h->script), "%s", script);
+    rec.used = rec.synced = sizeof(LktkRecHeader);
+    h->used = rec.used;
+}
+
+void rec_end(int keep) {
+    size_t used;
+    if (rec.fd < 0) {
+        return;
+    }
+    used = ((LktkRecHeader *)rec.base)->used;
+    if (keep) {
+        msync(rec.base, used < rec.size ? used : rec.size, MS_SYNC);
+    }
+    munmap(rec.base, rec.size);
+    rec.base = NULL;
+    if (keep) {
+        if (ftruncate(rec.fd, (off_t)used)) {
+            log_error("trace: %s: %s", rec.path, strerror(errno));
+        }
+        echo_info("trace: %s", rec.path);
+    } else {
+        unlink(rec.path);
+    }
+    rec_close();
+}
+
+static void rec_atexit(void) {
+    rec_end(1);
+}
+
+void rec_forked(void) {
+    static int registered;
+    if (rec.fd < 0) {
+        return;
+    }
+    /* the parent's mapping is shared: write a trace of our own */
+    rec_close();
+    rec_begin(rec.script, rec.iteration);
+    if (!registered) {
+        atexit(rec_atexit); /* nobody knows how a child's job went */
+        registered = 1;
+    }
+}
+
+static int rec_grow(size_t need) {
+    size_t size = rec.size;
+    void *p;
+    while (rec.used + need > size) {
+        size *= 2;
+    }
+    if (size == rec.size) {
+        return 0;
+    }
+    if (ftruncate(rec.fd, (off_t)size)) {
+        goto fail;
+    }
+    p = mremap(rec.base, rec.size, size, MREMAP_MAYMOVE);
+    if (MAP_FAILED == p) {
+        goto fail;
+    }
+    rec.base = (char *)p;
+    rec.size = size;
+    return 0;
+fail:
+    log_error("trace: %s stops growing: %s", rec.path, strerror(errno));
+    rec_end(1);
+    return -1;
+}
+
+size_t rec_payload_len(lua_State *L, int idx, LktkShape *shape) {
+    switch (lua_type(L, idx)) {
+    case LUA_TSTRING:
+        return lua_rawlen(L, idx) + 1;
+    case LUA_TUSERDATA:
+        return lktk_userdata_len(L, idx);
+    case LUA_TTABLE:
+        return shape ? shape->size : 0;
+    default:
+        return 0;
+    }
+}
+
+static LktkRecCall *rec_append(long nr, const long *argz,
+        const size_t *lens, const struct iovec *sqes, int nsqes) {
+    size_t len[LKTK_MAX_ARGS];
+    size_t size = sizeof(LktkRecCall), sqe_len = 0;
+    LktkRecCall *rc;
+    LktkRecPayload *pl;
+    char *p;
+    int i;
+    if (rec.fd < 0) {
+        return NULL;
+    }
+    for (i = 0; i < LKTK_MAX_ARGS; i++) {
+        len[i] = argz[i] && lens ? lens[i] : 0;
+        if (len[i] > LKTK_REC_MAXPAYLOAD) {
+            len[i] = LKTK_REC_MAXPAYLOAD;
+        }
+        if (len[i]) {
+            size += sizeof(LktkRecPayload) + pad8(len[i]);
+        }
+    }
+    for (i = 0; i < nsqes; i++) {
+        sqe_len += sqes[i].iov_len;
+    }
+    if (sqe_len) {
+        size += sizeof(LktkRecPayload) + pad8(sqe_len);
+    }
+    if (rec_grow(size)) {
+        return NULL;
+    }
+    rc = (LktkRecCall *)(rec.base + rec.used);
+    memset(rc, 0, sizeof(LktkRecCall));
+    rc->nr = (int32_t)nr;
+    for (i = 0; i < LKTK_MAX_ARGS; i++) {
+        rc->args[i] = (int64_t)argz[i];
+    }
+    rc->result = -1;
+    rc->error = LKTK_REC_PENDING;
+    p = (char *)(rc + 1);
+    for (i = 0; i < LKTK_MAX_ARGS; i++) {
+        if (!len[i]) {
+            continue;
+        }
+        pl = (LktkRecPayload *)p;
+        pl->arg = (uint32_t)i;
+        pl->len = (uint32_t)len[i];
+        memcpy(pl + 1, (const void *)argz[i], len[i]);
+        p += sizeof(LktkRecPayload) + pad8(len[i]);
+        rc->payloads++;
+    }
+    if (sqe_len) {
+        pl = (LktkRecPayload *)p;
+        pl->arg = LKTK_REC_SQES;
+        pl->len = (uint32_t)sqe_len;
+        p = (char *)(pl + 1);
+        for (i = 0; i < nsqes; i++) {
+            memcpy(p, sqes[i].iov_base, sqes[i].iov_len);
+            p += sqes[i].iov_len;
+        }
+        rc->payloads++;
+    }
+    rc->when = now_ns();
+    /* size last: a torn record reads as the end of the trace */
+    __atomic_store_n(&rc->size, (uint32_t)size, __ATOMIC_RELEASE);
+    rec.used += size;
+    ((LktkRecHeader *)rec.base)->used = rec.used;
+    if (rec.used - rec.synced >= REC_WRITEBACK) {
+        sync_file_range(rec.fd, (off_t)rec.synced,
+                (off_t)(rec.used - rec.synced), SYNC_FILE_RANGE_WRITE);
+        rec.synced = rec.used;
+    }
+    return rc;
+}
+
+LktkRecCall *rec_call(lua_State *L, int first, long nr, const long *argz,
+        LktkShape **shapez, int nargs) {
+    size_t lens[LKTK_MAX_ARGS] = {0};
+    int i;
+    if (rec.fd < 0) {
+        return NULL;
+    }
+    for (i = 0; i < nargs; i++) {
+        lens[i] = rec_payload_len(L, first + i, shapez[i]);
+    }
+    return rec_append(nr, argz, lens, NULL, 0);
+}
+
+LktkRecCall *rec_syscall(long nr, const long *argz, const size_t *lens) {
+    return rec_append(nr, argz, lens, NULL, 0);
+}
+
+LktkRecCall *rec_submit(const long *argz, const struct iovec *sqes, int n) {
+    return rec_append(__NR_io_uring_enter, argz, NULL, sqes, n);
+}
+
+/* argument pointing to the int[2] a call fills with new fds, or -1 */
+static int fd_pair_arg(long nr) {
+#ifdef __NR_pipe
+    if (__NR_pipe == nr) {
+        return 0;
+    }
+#endif
+    if (__NR_pipe2 == nr) {
+        return 0;
+    }
+    if (__NR_socketpair == nr) {
+        return 3;
+    }
+    return -1;
+}
+
+void rec_result(LktkRecCall *rc, long result, int error) {
+    const char *p;
+    uint32_t i;
+    int arg;
+    if (!rc) {
+        return;
+    }
+    rc->result = result;
+    rc->error = error;
+    arg = error ? -1 : fd_pair_arg(rc->nr);
+    if (arg < 0) {
+        return;
+    }
+    /* the new fds are all replay needs from it: keep them instead */
+    p = (const char *)(rc + 1);
+    for (i = 0; i < rc->payloads; i++) {
+        LktkRecPayload *pl = (LktkRecPayload *)p;
+        if ((uint32_t)arg == pl->arg && pl->len >= 2 * sizeof(int)) {
+            memcpy(pl + 1, (const void *)(long)rc->args[arg],
+                    2 * sizeof(int));
+        }
+        p += sizeof(*pl) + pad8(pl->len);
+    }
+}
+
+/*
+ * Replay: recorded fd -> fd of the replaying process
+ * Filled from the results of calls creating fds, applied to arguments
+ * of kind FD. Fds never created in the trace (std streams, inherited
+ * ones) and fds inside structs are passed on as recorded.
+ */
+static const char *fd_makers[] = {
+    "open", "openat", "openat2", "creat", "dup", "dup2", "dup3", "fcntl",
+    "socket", "accept", "accept4", "eventfd", "eventfd2", "epoll_create",
+    "epoll_create1", "signalfd", "signalfd4", "timerfd_create",
+    "inotify_init", "inotify_init1", "memfd_create", "memfd_secret",
+    "userfaultfd", "pidfd_open", "pidfd_getfd", "fanotify_init",
+    "perf_event_open", "open_by_handle_at", "fsopen", "fsmount", "fspick",
+    "open_tree", "io_uring_setup", "landlock_create_ruleset", "mq_open",
+    "pipe", "pipe2", "socketpair", NULL
+};
+
+static struct {
+    int *to;
+    int len;
+} fd_map;
+
+static int fd_maker(const char *name, const long *argz) {
+    const char **m;
+    if (!name) {
+        return 0;
+    }
+    if (!strcmp(name, "fcntl")) {
+        return F_DUPFD == argz[1] || F_DUPFD_CLOEXEC == argz[1];
+    }
+    for (m = fd_makers; *m; m++) {
+        if (!strcmp(*m, name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static long map_fd(long fd) {
+    if (fd >= 0 && fd < fd_map.len && fd_map.to[fd] >= 0) {
+        return fd_map.to[fd];
+    }
+    return fd;
+}
+
+static void set_fd(long from, long to) {
+    if (from < 0 || to < 0 || from >= (1 << 20)) {
+        return;
+    }
+    if (from >= fd_map.len) {
+        int len = (int)from + 64;
+        int *p = realloc(fd_map.to, (size_t)len * sizeof(int));
+        if (!p) {
+            return;
+        }
+        memset(p + fd_map.len, -1, (size_t)(len - fd_map.len) * sizeof(int));
+        fd_map.to = p;
+        fd_map.len = len;
+    }
+    fd_map.to[from] = (int)to;
+}
+
+int lktk_replay(const char *path) {
+    const LktkRecHeader *h;
+    struct utsname u;
+    struct stat st;
+    size_t off;
+    char *base;
+    int fd, calls = 0, differ = 0, submits = 0;
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) || (size_t)st.st_size < sizeof(*h)) {
+        echo_error("replay: cannot read %s", path);
+        return -1;
+    }
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) {
+        echo_error("replay: cannot map %s: %s", path, strerror(errno));
+        return -1;
+    }
+    h = (const LktkRecHeader *)base;
+    if (memcmp(h->magic, LKTK_REC_MAGIC, sizeof(h->magic))) {
+        echo_error("replay: %s is not a trace", path);
+        return -1;
+    }
+    if (!uname(&u) && strncmp(u.machine, h->arch, sizeof(h->arch))) {
+        echo_error("replay: trace of %.16s, this is %s", h->arch, u.machine);
+        return -1;
+    }
+    echo_info("replay: %.224s #%d, pid %d, seed %llu", h->script,
+            h->iteration, h->pid, (unsigned long long)h->seed);
+    for (off = sizeof(*h); off + sizeof(LktkRecCall) <= (size_t)st.st_size;) {
+        const LktkRecCall *rc = (const LktkRecCall *)(base + off);
+        const char *p = (const char *)(rc + 1);
+        void *copies[LKTK_MAX_ARGS] = {0};
+        const struct io_uring_sqe *sqes = NULL;
+        unsigned nsqes = 0;
+        long argz[LKTK_MAX_ARGS];
+        const LktkSyscallProto *proto;
+        const char *name;
+        const int *pair_was = NULL;
+        long result;
+        int i, error = 0, maker, same;
+        int pair = fd_pair_arg(rc->nr);
+        if (rc->size < sizeof(*rc) || off + rc->size > (size_t)st.st_size) {
+            break;
+        }
+        for (i = 0; i < LKTK_MAX_ARGS; i++) {
+            argz[i] = (long)rc->args[i];
+        }
+        for (i = 0; i < (int)rc->payloads; i++) {
+            const LktkRecPayload *pl = (const LktkRecPayload *)p;
+            if (LKTK_REC_SQES == pl->arg) {
+                sqes = (const struct io_uring_sqe *)(pl + 1);
+                nsqes = pl->len / sizeof(*sqes);
+            } else if (pl->arg < LKTK_MAX_ARGS && !copies[pl->arg]) {
+                if ((uint32_t)pair == pl->arg && pl->len >= 2 * sizeof(int)) {
+                    pair_was = (const int *)(pl + 1);
+                }
+                copies[pl->arg] = malloc(pl->len);
+                if (copies[pl->arg]) {
+                    memcpy(copies[pl->arg], pl + 1, pl->len);
+                    argz[pl->arg] = (long)copies[pl->arg];
+                }
+            }
+            p += sizeof(*pl) + pad8(pl->len);
+        }
+        name = lktk_syscall_name(rc->nr);
+        if (sqes) {
+            /* the ring is gone: what was submitted is all we have */
+            echo_warn("%s(#%d) = %ld (%d), %u SQEs, not replayed",
+                    name ? name : "?", rc->nr, (long)rc->result, rc->error,
+                    nsqes);
+            for (i = 0; kit.verbose && i < (int)nsqes; i++) {
+                echo_info("  sqe op %u fd %d addr 0x%llx len %u off 0x%llx",
+                        sqes[i].opcode, sqes[i].fd,
+                        (unsigned long long)sqes[i].addr, sqes[i].len,
+                        (unsigned long long)sqes[i].off);
+            }
+            for (i = 0; i < LKTK_MAX_ARGS; i++) {
+                free(copies[i]);
+            }
+            submits++;
+            off += rc->size;
+            continue;
+        }
+        proto = name ? lktk_syscall_proto(name) : NULL;
+        /* kinds only: nargs is counted when the Lua module loads */
+        for (i = 0; proto && i < LKTK_MAX_ARGS; i++) {
+            if (LKTK_ARG_FD == proto->args[i]) {
+                argz[i] = map_fd(argz[i]);
+            }
+        }
+        maker = fd_maker(name, argz);
+        fflush(stdout); /* the next call may be the last one */
+        result = syscall(rc->nr, argz[0], argz[1], argz[2],
+                argz[3], argz[4], argz[5]);
+        if (-1 == result) {
+            error = errno;
+        }
+        same = result == rc->result && error == rc->error;
+        if (maker && !error && !rc->error) {
+            if (pair < 0) {
+                set_fd((long)rc->result, result);
+                same = 1; /* another number for the same fd */
+            } else if (pair_was && copies[pair]) {
+                const int *now = (const int *)copies[pair];
+                set_fd(pair_was[0], now[0]);
+                set_fd(pair_was[1], now[1]);
+            }
+        }
+        if (LKTK_REC_PENDING == rc->error) {
+            echo_error("%s(#%d) = %ld (%d), did not return when recorded",
+                    name ? name : "?", rc->nr, result, error);
+        } else if (!same) {
+            echo_warn("%s(#%d) = %ld (%d), recorded %ld (%d)",
+                    name ? name : "?", rc->nr, result, error,
+                    (long)rc->result, rc->error);
+            differ++;
+        } else if (kit.verbose) {
+            echo_info("%s(#%d) = %ld (%d)", name ? name : "?", rc->nr,
+                    result, error);
+        }
+        for (i = 0; i < LKTK_MAX_ARGS; i++) {
+            free(copies[i]);
+        }
+        calls++;
+        off += rc->size;
+    }
+    echo_info("replay: %d calls, %d with other results", calls, differ);
+    if (submits) {
+        echo_info("replay: %d uring submissions listed only", submits);
+    }
+    munmap(base, (size_t)st.st_size);
+    free(fd_map.to);
+    fd_map.to = NULL;
+    fd_map.len = 0;
+    return 0;
+}
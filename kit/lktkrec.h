@@ -0,0 +1,88 @@
+#ifndef LKTKREC_H
+#define LKTKREC_H
+
+#include "lktklib.h"
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*
+ * Reproducer traces (-R dir)
+ * Every job writes dir/<script>.<iteration>.<pid>.trace through a
+ * shared file mapping: a header, then one record per syscall issued
+ * by sysCall, syscall_batch, the fuzzer and uring submissions, with
+ * the bytes its pointer arguments pointed to before the call (for
+ * pipe, pipe2 and socketpair: the new fds, after the call). A
+ * submission record is io_uring_enter with the SQEs it passed on as
+ * an LKTK_REC_SQES payload. A record is
+ * complete before the syscall is issued, its result is filled in
+ * after: a call that never returned shows up as the last record with
+ * LKTK_REC_PENDING. Traces of clean jobs are removed at the end.
+ * A job forked off after rec_begin (lktk -F) writes on through the
+ * inherited mapping; rec_end goes by the length kept in the header.
+ *
+ * Records land in the page cache, not on disk: a trace outlives the
+ * job crashing, hanging or being killed, but not the kernel. Writeback
+ * is started (not waited for) every 64k, so after a panic or a reboot
+ * the trace usually ends well before the call that took the kernel
+ * down; capture those runs with a console log instead.
+ *
+ * lktk --replay file issues the calls again, with copies of the
+ * recorded bytes in place of the pointers, without Lua. Fd arguments
+ * are translated to the fds the replayed calls created. Rings are not
+ * set up again: uring submissions are listed, not issued.
+ */
+
+#define LKTK_REC_MAGIC "LKTKREC1"
+#define LKTK_REC_PENDING INT32_MIN /* error of a call in flight */
+#define LKTK_REC_MAXPAYLOAD (64 << 10) /* bytes kept per argument */
+#define LKTK_REC_SQES 0xffff /* payload arg of the SQEs of a submission */
+
+struct TLktkRecHeader {
+    char magic[8];
+    char arch[16];
+    uint64_t seed;
+    int32_t iteration;
+    int32_t pid;
+    uint64_t used; /* bytes written, header included */
+    char script[224];
+};
+typedef struct TLktkRecHeader LktkRecHeader;
+
+struct TLktkRecCall {
+    uint32_t size; /* of the record with payloads, 8-aligned */
+    int32_t nr;
+    int64_t args[LKTK_MAX_ARGS];
+    int64_t result;
+    int32_t error;
+    uint32_t payloads;
+    uint64_t when; /* CLOCK_MONOTONIC, ns */
+};
+typedef struct TLktkRecCall LktkRecCall;
+
+/* followed by len bytes, padded to 8 */
+struct TLktkRecPayload {
+    uint32_t arg;
+    uint32_t len;
+};
+typedef struct TLktkRecPayload LktkRecPayload;
+
+/* set by -R */
+extern const char *lktk_rec_dir;
+
+void rec_begin(const char *script, int iteration);
+void rec_end(int keep);
+void rec_forked(void);
+/* args at stack index first.., converted to argz; NULL when off */
+LktkRecCall *rec_call(lua_State *L, int first, long nr, const long *argz,
+        LktkShape **shapez, int nargs);
+/* bytes behind the Lua value at idx, as rec_call keeps them */
+size_t rec_payload_len(lua_State *L, int idx, LktkShape *shape);
+/* lens[i] bytes at argz[i] (0: a plain number); NULL when off */
+LktkRecCall *rec_syscall(long nr, const long *argz, const size_t *lens);
+/* io_uring_enter(argz...) passing on the SQEs in sqes[0..n) */
+LktkRecCall *rec_submit(const long *argz, const struct iovec *sqes, int n);
+void rec_result(LktkRecCall *rc, long result, int error);
+
+int lktk_replay(const char *path);
+
+#endif
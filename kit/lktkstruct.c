@@ -0,0 +1,445 @@
+#define _GNU_SOURCE /* struct statx, MAX_HANDLE_SZ, *64 */
+
+#include "lktkstruct.h"
+#include "lktkbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/times.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/msg.h>
+#include <sys/sem.h>
+#include <sys/shm.h>
+#include <sys/statfs.h>
+#include <sys/sysinfo.h>
+#include <sys/timex.h>
+#include <sys/utsname.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <utime.h>
+#include <mqueue.h>
+#include <linux/aio_abi.h>
+#include <linux/perf_event.h>
+#include <linux/kexec.h>
+#include <linux/futex.h>
+#include <linux/sysctl.h>
+#include <linux/bpf.h>
+#include "sched/types.h"
+
+/*
+ * Kernel ABI structs without a userspace header
+ */
+
+/* struct file_handle with room for the largest handle */
+struct lktk_file_handle {
+    unsigned int handle_bytes;
+    int handle_type;
+    unsigned char f_handle[MAX_HANDLE_SZ];
+};
+_Static_assert(offsetof(struct lktk_file_handle, f_handle)
+        == offsetof(struct file_handle, f_handle), "file_handle layout");
+
+struct list_head {
+    struct list_head *next;
+    struct list_head *prev;
+};
+
+struct mmap_arg_struct {
+    unsigned long addr;
+    unsigned long len;
+    unsigned long prot;
+    unsigned long flags;
+    unsigned long fd;
+    unsigned long offset;
+};
+
+struct sel_arg_struct {
+    unsigned long n;
+    fd_set *inp;
+    fd_set *outp;
+    fd_set *exp;
+    struct timeval *tvp;
+};
+
+struct old_utsname {
+    char sysname[65];
+    char nodename[65];
+    char release[65];
+    char version[65];
+    char machine[65];
+};
+
+struct oldold_utsname {
+    char sysname[9];
+    char nodename[9];
+    char release[9];
+    char version[9];
+    char machine[9];
+};
+
+/* descriptor of member 'path' of lktk_ctype_<name> */
+#define MEMBER(name, path) (((lktk_ctype_##name *)0)->path)
+#define DESC(name, key, path, kind) {#key,\
+    offsetof(lktk_ctype_##name, path), sizeof(MEMBER(name, path)),\
+    kind, 0},
+#define DESC_INT(name, key, path, kind) {#key,\
+    offsetof(lktk_ctype_##name, path), sizeof(MEMBER(name, path)),\
+    kind, ((__typeof__(MEMBER(name, path)))-1 < (__typeof__(MEMBER(name, path)))1)},
+
+/* 1st pass: C types and field arrays */
+#define LKTK_STRUCT(name, ctype, dir) typedef ctype lktk_ctype_##name;\
+    static const LktkField fields_##name[] = {
+#define LKTK_FIELD(name, field) DESC_INT(name, field, field, LKTK_FLD_INT)
+#define LKTK_FIELD_AS(name, key, path) DESC_INT(name, key, path, LKTK_FLD_INT)
+#define LKTK_SIZE(name, field) DESC_INT(name, field, field, LKTK_FLD_SIZE)
+#define LKTK_PTR(name, field) DESC(name, field, field, LKTK_FLD_PTR)
+#define LKTK_PTR_AS(name, key, path) DESC(name, key, path, LKTK_FLD_PTR)
+#define LKTK_STR(name, field) DESC(name, field, field, LKTK_FLD_STR)
+#define LKTK_BYTES(name, field) DESC(name, field, field, LKTK_FLD_BYTES)
+#define LKTK_RAW(name, key, off, size) {#key, (off), (size), LKTK_FLD_INT, 0},
+#define LKTK_END(name) {NULL, 0, 0, 0, 0}};
+#include "lktkstruct.def"
+#undef LKTK_STRUCT
+#undef LKTK_END
+
+/* 2nd pass: struct table indexed by datatype */
+#define LKTK_STRUCT(name, ctype, dir) [LKTK_##name] = {#name,\
+    sizeof(lktk_ctype_##name), LKTK_DIR_##dir, fields_##name},
+#define LKTK_END(name)
+#undef LKTK_FIELD
+#undef LKTK_FIELD_AS
+#undef LKTK_SIZE
+#undef LKTK_PTR
+#undef LKTK_PTR_AS
+#undef LKTK_STR
+#undef LKTK_BYTES
+#undef LKTK_RAW
+#define LKTK_FIELD(name, field)
+#define LKTK_FIELD_AS(name, key, path)
+#define LKTK_SIZE(name, field)
+#define LKTK_PTR(name, field)
+#define LKTK_PTR_AS(name, key, path)
+#define LKTK_STR(name, field)
+#define LKTK_BYTES(name, field)
+#define LKTK_RAW(name, key, off, size)
+static const LktkStruct lktk_structs[LKTK_DATATYPES] = {
+#include "lktkstruct.def"
+};
+
+const LktkStruct *lktk_struct(int datatype) {
+    if (datatype <= 0 || datatype >= LKTK_DATATYPES) {
+        return NULL;
+    }
+    return &lktk_structs[datatype];
+}
+
+static inline void store_int(char *p, unsigned width, lua_Integer v) {
+    switch (width) {
+    case 1: { uint8_t x = (uint8_t)v; memcpy(p, &x, 1); break; }
+    case 2: { uint16_t x = (uint16_t)v; memcpy(p, &x, 2); break; }
+    case 4: { uint32_t x = (uint32_t)v; memcpy(p, &x, 4); break; }
+    default: { uint64_t x = (uint64_t)v; memcpy(p, &x, 8); break; }
+    }
+}
+
+static inline lua_Integer load_int(const char *p, unsigned width, int is_signed) {
+    switch (width) {
+    case 1: { uint8_t x; memcpy(&x, p, 1);
+        return is_signed ? (lua_Integer)(int8_t)x : (lua_Integer)x; }
+    case 2: { uint16_t x; memcpy(&x, p, 2);
+        return is_signed ? (lua_Integer)(int16_t)x : (lua_Integer)x; }
+    case 4: { uint32_t x; memcpy(&x, p, 4);
+        return is_signed ? (lua_Integer)(int32_t)x : (lua_Integer)x; }
+    default: { uint64_t x; memcpy(&x, p, 8); return (lua_Integer)x; }
+    }
+}
+
+/* value at 'vidx' --> field at 'p' (nil and unknown types are ignored) */
+static void store_field(lua_State *L, int vidx, const LktkField *f, char *p) {
+    size_t len;
+    switch (f->kind) {
+    case LKTK_FLD_INT:
+    case LKTK_FLD_SIZE:
+        if (LUA_TNUMBER == lua_type(L, vidx)) {
+            store_int(p, f->width, lua_tointeger(L, vidx));
+        } else if (LUA_TBOOLEAN == lua_type(L, vidx)) {
+            store_int(p, f->width, lua_toboolean(L, vidx));
+        }
+        break;
+    case LKTK_FLD_PTR:
+        /* strings and userdata must be kept alive by the caller */
+        switch (lua_type(L, vidx)) {
+        case LUA_TNUMBER:
+            store_int(p, f->width, lua_tointeger(L, vidx));
+            break;
+        case LUA_TSTRING:
+            store_int(p, f->width, (lua_Integer)lua_tostring(L, vidx));
+            break;
+        case LUA_TUSERDATA:
+            store_int(p, f->width, (lua_Integer)lktk_userdata_ptr(L, vidx));
+            break;
+        case LUA_TLIGHTUSERDATA:
+            store_int(p, f->width, (lua_Integer)lua_touserdata(L, vidx));
+            break;
+        }
+        break;
+    case LKTK_FLD_STR:
+    case LKTK_FLD_BYTES:
+        if (LUA_TSTRING == lua_type(L, vidx)) {
+            const char *s = lua_tolstring(L, vidx, &len);
+            size_t room = f->width - (LKTK_FLD_STR == f->kind);
+            if (len > room) {
+                len = room;
+            }
+            memcpy(p, s, len);
+            memset(p + len, 0, f->width - len);
+        }
+        break;
+    }
+}
+
+/* field at 'p' --> lua stack */
+static void push_field(lua_State *L, const LktkField *f, const char *p) {
+    switch (f->kind) {
+    case LKTK_FLD_STR:
+        lua_pushlstring(L, p, strnlen(p, f->width));
+        break;
+    case LKTK_FLD_BYTES:
+        lua_pushlstring(L, p, f->width);
+        break;
+    default:
+        lua_pushinteger(L, load_int(p, f->width, f->is_signed));
+        break;
+    }
+}
+
+/*
+ * Field names are interned once per state (inject_lktkstruct) into a
+ * registry table: type -> {name, ...} in field order. Pack and unpack
+ * push those strings with lua_rawgeti, so a lookup compares interned
+ * pointers instead of hashing the name again. A table without
+ * metatable (the usual {__type = ...} argument) is read with
+ * lua_rawget; others go through lua_gettable for __index.
+ */
+static char field_keys_key;
+
+static void intern_field_keys(lua_State *L) {
+    const LktkField *f;
+    int i, n;
+    lua_createtable(L, LKTK_DATATYPES, 0);
+    for (i = 1; i < LKTK_DATATYPES; i++) {
+        lua_newtable(L);
+        for (f = lktk_structs[i].fields, n = 1; f->key; f++, n++) {
+            lua_pushstring(L, f->key);
+            lua_rawseti(L, -2, n);
+        }
+        lua_rawseti(L, -2, i);
+    }
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &field_keys_key);
+}
+
+/* pushes the field names of st */
+static int push_field_keys(lua_State *L, const LktkStruct *st) {
+    luaL_checkstack(L, 4, "struct fields");
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &field_keys_key);
+    lua_rawgeti(L, -1, st - lktk_structs);
+    lua_remove(L, -2);
+    return lua_gettop(L);
+}
+
+/*
+ * lua table --> C struct
+ * Fields missing in the table (nil) are left as they are in the
+ * buffer (zeroed when created), so union members do not clobber
+ * each other.
+ */
+void lktk_struct_pack(lua_State *L, int idx, const LktkStruct *st, void *ud) {
+    const LktkField *f;
+    int keys, raw, n;
+    idx = lua_absindex(L, idx);
+    keys = push_field_keys(L, st);
+    raw = !lua_getmetatable(L, idx);
+    if (!raw) {
+        lua_pop(L, 1);
+    }
+    for (f = st->fields, n = 1; f->key; f++, n++) {
+        char *p = (char *)ud + f->offset;
+        lua_rawgeti(L, keys, n);
+        if (LUA_TNIL == (raw ? lua_rawget(L, idx) : lua_gettable(L, idx))) {
+            lua_pop(L, 1);
+            if (LKTK_FLD_SIZE == f->kind) {
+                store_int(p, f->width, (lua_Integer)st->size);
+            }
+            continue;
+        }
+        /* strings and userdata are anchored by the table */
+        store_field(L, -1, f, p);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+}
+
+/* C struct --> lua table */
+void lktk_struct_unpack(lua_State *L, int idx, const LktkStruct *st,
+        const void *ud) {
+    const LktkField *f;
+    int keys, n;
+    idx = lua_absindex(L, idx);
+    keys = push_field_keys(L, st);
+    for (f = st->fields, n = 1; f->key; f++, n++) {
+        if (LKTK_FLD_PTR == f->kind) {
+            continue; /* pointers stay as set by the script */
+        }
+        lua_rawgeti(L, keys, n);
+        push_field(L, f, (const char *)ud + f->offset);
+        lua_settable(L, idx);
+    }
+    lua_pop(L, 1);
+}
+
+/*
+ * Struct objects: s = struct(stat [, {field = value, ...}])
+ * A full userdata holding just the C struct, passed to syscall as
+ * a plain pointer (no copies, no table writes); fields are read and
+ * written in place through __index/__newindex, #s is the size.
+ * One metatable per struct type, with upvalues:
+ *   1: field name -> descriptor (light userdata)
+ *   2: struct description (light userdata)
+ * Strings assigned to pointer fields are anchored in the uservalue.
+ */
+static char struct_meta_key;
+
+static const LktkField *check_field(lua_State *L) {
+    const LktkField *f;
+    lua_pushvalue(L, 2);
+    if (LUA_TLIGHTUSERDATA != lua_rawget(L, lua_upvalueindex(1))) {
+        const LktkStruct *st = (const LktkStruct *)
+                lua_touserdata(L, lua_upvalueindex(2));
+        luaL_error(L, "struct %s has no field '%s'",
+                st->name, luaL_tolstring(L, 2, NULL));
+    }
+    f = (const LktkField *)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return f;
+}
+
+static int structIndex(lua_State *L) {
+    const LktkField *f = check_field(L);
+    push_field(L, f, (const char *)lua_touserdata(L, 1) + f->offset);
+    return 1;
+}
+
+static void set_field(lua_State *L, const LktkField *f, int vidx) {
+    store_field(L, vidx, f, (char *)lua_touserdata(L, 1) + f->offset);
+    if (LKTK_FLD_PTR == f->kind) {
+        if (LUA_TTABLE != lua_getuservalue(L, 1)) {
+            lua_pop(L, 1);
+            lua_newtable(L);
+            lua_pushvalue(L, -1);
+            lua_setuservalue(L, 1);
+        }
+        lua_pushstring(L, f->key);
+        lua_pushvalue(L, vidx);
+        lua_rawset(L, -3);
+        lua_pop(L, 1);
+    }
+}
+
+static int structNewIndex(lua_State *L) {
+    set_field(L, check_field(L), 3);
+    return 0;
+}
+
+static int structLen(lua_State *L) {
+    const LktkStruct *st = (const LktkStruct *)
+            lua_touserdata(L, lua_upvalueindex(2));
+    lua_pushinteger(L, (lua_Integer)st->size);
+    return 1;
+}
+
+/* pushes the metatable of 'datatype', created on first use */
+static void push_struct_meta(lua_State *L, int datatype,
+        const LktkStruct *st) {
+    const LktkField *f;
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &struct_meta_key);
+    if (LUA_TTABLE == lua_rawgeti(L, -1, datatype)) {
+        lua_remove(L, -2);
+        return;
+    }
+    lua_pop(L, 1);
+    lua_createtable(L, 0, 4);
+    lua_pushstring(L, st->name);
+    lua_setfield(L, -2, "__name");
+    lua_newtable(L);
+    for (f = st->fields; f->key; f++) {
+        lua_pushlightuserdata(L, (void *)f);
+        lua_setfield(L, -2, f->key);
+    }
+    lua_pushlightuserdata(L, (void *)st);
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, structIndex, 2);
+    lua_setfield(L, -4, "__index");
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, -2);
+    lua_pushcclosure(L, structNewIndex, 2);
+    lua_setfield(L, -4, "__newindex");
+    lua_pushcclosure(L, structLen, 2);
+    lua_setfield(L, -2, "__len");
+    lua_pushvalue(L, -1);
+    lua_rawseti(L, -3, datatype);
+    lua_remove(L, -2);
+}
+
+static int structNew(lua_State *L) {
+    int datatype = (int)luaL_checkinteger(L, 1);
+    const LktkStruct *st = lktk_struct(datatype);
+    const LktkField *f;
+    luaL_argcheck(L, st, 1, "unknown struct type");
+    lua_settop(L, 2);
+    char *ud = (char *)lua_newuserdata(L, st->size);
+    memset(ud, 0, st->size);
+    for (f = st->fields; f->key; f++) {
+        if (LKTK_FLD_SIZE == f->kind) {
+            store_int(ud + f->offset, f->width, (lua_Integer)st->size);
+        }
+    }
+    push_struct_meta(L, datatype, st);
+    lua_setmetatable(L, -2);
+    if (!lua_isnil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TTABLE);
+        lua_replace(L, 1); /* object at 1, as for __newindex */
+        lua_getmetatable(L, 1);
+        lua_getfield(L, -1, "__newindex");
+        lua_pushnil(L);
+        while (lua_next(L, 2)) {
+            /* through the metamethod: unknown fields raise errors */
+            lua_pushvalue(L, -3);
+            lua_pushvalue(L, 1);
+            lua_pushvalue(L, -4);
+            lua_pushvalue(L, -4);
+            lua_call(L, 3, 0);
+            lua_pop(L, 1);
+        }
+        lua_settop(L, 1);
+    }
+    return 1;
+}
+
+void inject_lktkstruct(lua_State *L) {
+    intern_field_keys(L);
+    lua_newtable(L);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &struct_meta_key);
+    lua_register(L, "struct", structNew);
+}
+
+void lktk_struct_handles(lua_State *L) {
+    int i;
+    for (i = 1; i < LKTK_DATATYPES; i++) {
+        lua_pushinteger(L, i);
+        lua_setfield(L, -2, lktk_structs[i].name);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef LKTKSTRUCT_H
+#define LKTKSTRUCT_H
+
+#include "lktklib.h"
+
+/*
+ * Table-driven struct marshalling
+ * Each struct type is a list of field descriptors generated from
+ * lktkstruct.def; one generic loop packs a Lua table into the C
+ * struct and another one unpacks it back.
+ */
+
+enum {
+    LKTK_FLD_INT,   /* integer, sign extended when 'is_signed' */
+    LKTK_FLD_SIZE,  /* integer, struct size if not set */
+    LKTK_FLD_PTR,   /* pointer, input only */
+    LKTK_FLD_STR,   /* char array, NUL terminated */
+    LKTK_FLD_BYTES  /* char array, raw */
+};
+
+#define LKTK_DIR_IN 1
+#define LKTK_DIR_OUT 2
+#define LKTK_DIR_INOUT (LKTK_DIR_IN | LKTK_DIR_OUT)
+
+struct TLktkField {
+    const char *key;
+    unsigned short offset;
+    unsigned short width;
+    unsigned char kind;
+    unsigned char is_signed;
+};
+typedef struct TLktkField LktkField;
+
+struct TLktkStruct {
+    const char *name;
+    size_t size;
+    int dir;
+    const LktkField *fields; /* terminated by NULL key */
+};
+typedef struct TLktkStruct LktkStruct;
+
+/* NULL for unknown datatype */
+const LktkStruct *lktk_struct(int datatype);
+void lktk_struct_pack(lua_State *L, int idx, const LktkStruct *st, void *ud);
+void lktk_struct_unpack(lua_State *L, int idx, const LktkStruct *st,
+        const void *ud);
+/* struct handles (stat, flock, ...) into the table on top */
+void lktk_struct_handles(lua_State *L);
+/* struct(type [, init]) objects */
+void inject_lktkstruct(lua_State *L);
+
+#endif
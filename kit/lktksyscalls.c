@@ -0,0 +1,207 @@
+#include "lktksyscalls.h"
+
+/*
+ * Syscall tables
+ * Numbers come from syscalls_<arch>.h, generated at build time from
+ * the kernel UAPI headers by gensyscalls.sh; prototypes (argument
+ * kinds) from lktksyscalls.def. Both are constant arrays: nothing is
+ * parsed at startup.
+ *   require "syscalls"          numbers for the arch lktk runs on
+ *   require "syscalls.<arch>"   x86_64, i386 or arm64
+ * The modules are read-only tables: sys.getpid == 39 (on x86_64).
+ *   syscall_info(nr | name [, arch]) -> {name=, nr=, nargs=, args={...}}
+ */
+
+#define LKTK_NR(name, nr) {#name, nr},
+static const LktkSyscallNr nr_x86_64[] = {
+#include "syscalls_x86_64.h"
+    {NULL, -1}
+};
+static const LktkSyscallNr nr_i386[] = {
+#include "syscalls_i386.h"
+    {NULL, -1}
+};
+static const LktkSyscallNr nr_arm64[] = {
+#include "syscalls_arm64.h"
+    {NULL, -1}
+};
+#undef LKTK_NR
+
+static const struct {
+    const char *arch;
+    const LktkSyscallNr *table;
+} arches[] = {
+    {"x86_64", nr_x86_64},
+    {"i386", nr_i386},
+    {"arm64", nr_arm64},
+    {NULL, NULL}
+};
+
+#if defined(__x86_64__)
+#define NATIVE_ARCH 0
+#elif defined(__i386__)
+#define NATIVE_ARCH 1
+#elif defined(__aarch64__)
+#define NATIVE_ARCH 2
+#else
+#error "unsupported arch: no syscall table"
+#endif
+
+#define LKTK_PROTO(name, a1, a2, a3, a4, a5, a6) {#name, -1,\
+    {LKTK_ARG_##a1, LKTK_ARG_##a2, LKTK_ARG_##a3,\
+     LKTK_ARG_##a4, LKTK_ARG_##a5, LKTK_ARG_##a6}},
+static LktkSyscallProto protos[] = {
+#include "lktksyscalls.def"
+    {NULL, -1, {0}}
+};
+#undef LKTK_PROTO
+
+#define LKTK_ARG_NAME(k) #k,
+static const char *arg_kind_names[] = { LKTK_ARG_KINDS(LKTK_ARG_NAME) };
+#undef LKTK_ARG_NAME
+static char arg_kind_lower[LKTK_ARG_COUNT][8];
+
+const char *lktk_arg_kind_name(int kind) {
+    if (kind <= 0 || kind >= LKTK_ARG_COUNT) {
+        return NULL;
+    }
+    return arg_kind_lower[kind];
+}
+
+const char *lktk_syscall_name(int nr) {
+    const LktkSyscallNr *s;
+    for (s = arches[NATIVE_ARCH].table; s->name; s++) {
+        if (s->nr == nr) {
+            return s->name;
+        }
+    }
+    return NULL;
+}
+
+const LktkSyscallProto *lktk_syscall_proto(const char *name) {
+    LktkSyscallProto *p;
+    for (p = protos; p->name; p++) {
+        if (!strcmp(p->name, name)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static int arch_index(lua_State *L, int idx) {
+    int i;
+    if (lua_isnoneornil(L, idx)) {
+        return NATIVE_ARCH;
+    }
+    const char *arch = luaL_checkstring(L, idx);
+    for (i = 0; arches[i].arch; i++) {
+        if (!strcmp(arches[i].arch, arch)) {
+            return i;
+        }
+    }
+    return luaL_argerror(L, idx, "unknown arch");
+}
+
+static int readonly(lua_State *L) {
+    return luaL_error(L, "syscall table is read-only (%s)",
+            luaL_tolstring(L, 2, NULL));
+}
+
+static int proxy_pairs(lua_State *L) {
+    lua_getglobal(L, "next");
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, "__index");
+    lua_remove(L, -2);
+    lua_pushnil(L);
+    return 3;
+}
+
+/* package.preload loader, upvalue: arch index */
+static int load_syscalls(lua_State *L) {
+    const LktkSyscallNr *s;
+    int arch = (int)lua_tointeger(L, lua_upvalueindex(1));
+    int n = 0;
+    for (s = arches[arch].table; s->name; s++) {
+        n++;
+    }
+    lua_newtable(L); /* proxy */
+    lua_createtable(L, 0, 4);
+    lua_createtable(L, 0, n);
+    for (s = arches[arch].table; s->name; s++) {
+        lua_pushinteger(L, s->nr);
+        lua_setfield(L, -2, s->name);
+    }
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, readonly);
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, proxy_pairs);
+    lua_setfield(L, -2, "__pairs");
+    lua_pushstring(L, arches[arch].arch);
+    lua_setfield(L, -2, "__metatable"); /* no getmetatable tricks */
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+// syscall_info(nr | name [, arch]) -> table | nil
+static int syscallInfo(lua_State *L) {
+    const LktkSyscallNr *s;
+    const LktkSyscallProto *p;
+    int arch = arch_index(L, 2);
+    int i;
+    for (s = arches[arch].table; s->name; s++) {
+        if (lua_isinteger(L, 1) ? (s->nr == lua_tointeger(L, 1))
+                : !strcmp(s->name, luaL_checkstring(L, 1))) {
+            break;
+        }
+    }
+    if (!s->name) {
+        lua_pushnil(L);
+        return 1;
+    }
+    p = lktk_syscall_proto(s->name);
+    lua_createtable(L, 0, 4);
+    lua_pushstring(L, s->name);
+    lua_setfield(L, -2, "name");
+    lua_pushinteger(L, s->nr);
+    lua_setfield(L, -2, "nr");
+    lua_pushinteger(L, p ? p->nargs : -1);
+    lua_setfield(L, -2, "nargs");
+    if (p) {
+        lua_createtable(L, p->nargs, 0);
+        for (i = 0; i < p->nargs; i++) {
+            lua_pushstring(L, lktk_arg_kind_name(p->args[i]));
+            lua_rawseti(L, -2, i + 1);
+        }
+        lua_setfield(L, -2, "args");
+    }
+    return 1;
+}
+
+void inject_lktksyscalls(lua_State *L) {
+    LktkSyscallProto *p;
+    int i, j;
+    for (i = 1; i < LKTK_ARG_COUNT; i++) {
+        for (j = 0; arg_kind_names[i][j] && j < 7; j++) {
+            arg_kind_lower[i][j] = (char)(arg_kind_names[i][j] | 0x20);
+        }
+    }
+    for (p = protos; p->name; p++) {
+        for (p->nargs = 0; p->nargs < LKTK_MAX_ARGS
+                && p->args[p->nargs]; p->nargs++);
+    }
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_PRELOAD_TABLE);
+    lua_pushinteger(L, NATIVE_ARCH);
+    lua_pushcclosure(L, load_syscalls, 1);
+    lua_setfield(L, -2, "syscalls");
+    for (i = 0; arches[i].arch; i++) {
+        const char *name = lua_pushfstring(L, "syscalls.%s", arches[i].arch);
+        lua_pushinteger(L, i);
+        lua_pushcclosure(L, load_syscalls, 1);
+        lua_setfield(L, -3, name);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    lua_register(L, "syscall_info", syscallInfo);
+    lua_pushstring(L, arches[NATIVE_ARCH].arch);
+    lua_setglobal(L, "ARCH");
+}
@@ -0,0 +1,37 @@
+#ifndef LKTKSYSCALLS_H
+#define LKTKSYSCALLS_H
+
+#include "lktklib.h"
+
+/* argument kinds of syscall prototypes (lktksyscalls.def) */
+#define LKTK_ARG_KINDS(X) \
+    X(_) X(INT) X(UINT) X(FD) X(PATH) X(STR) X(BUF) X(OBUF) X(LEN) \
+    X(FLAGS) X(MODE) X(PID) X(UID) X(GID) X(SIG) X(PTR) X(ADDR) X(OFF) \
+    X(CMD)
+
+#define LKTK_ARG_ENUM(k) LKTK_ARG_##k,
+enum { LKTK_ARG_KINDS(LKTK_ARG_ENUM) LKTK_ARG_COUNT };
+#undef LKTK_ARG_ENUM
+
+struct TLktkSyscallProto {
+    const char *name;
+    int nargs;
+    unsigned char args[LKTK_MAX_ARGS];
+};
+typedef struct TLktkSyscallProto LktkSyscallProto;
+
+struct TLktkSyscallNr {
+    const char *name;
+    int nr;
+};
+typedef struct TLktkSyscallNr LktkSyscallNr;
+
+/* tables of the arch lktk is built for */
+const char *lktk_syscall_name(int nr);
+const LktkSyscallProto *lktk_syscall_proto(const char *name);
+/* lowercase kind name: "fd", "path", ... */
+const char *lktk_arg_kind_name(int kind);
+
+void inject_lktksyscalls(lua_State *L);
+
+#endif
@@ -0,0 +1,537 @@
+
+#include "lktkuring.h"
+#include "lktkrec.h"
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+/*
+ * Asynchronous syscalls via io_uring (raw syscalls, no liburing)
+ *
+ *   local ring = uring(depth [, URING_SQPOLL])
+ *   local tag = ring:prep(op, fd, addr, len, off, op_flags)
+ *   ring:submit([wait_nr])
+ *   local tags, results = ring:reap([min_complete])
+ *   ring:close()
+ *
+ * prep() maps its arguments 1:1 onto the SQE fields, e.g.
+ *   URING_READ/WRITE  fd, buf, len, offset
+ *   URING_FSYNC       fd, nil, 0, 0, fsync_flags
+ *   URING_OPENAT      dirfd, path, mode, 0, open_flags
+ *   URING_STATX       dirfd, path, mask, statx_buf, statx_flags
+ * Arguments are converted like syscall() args (strings, userdata,
+ * struct tables) and kept alive until the completion is reaped;
+ * struct tables are marshalled back on reap.
+ * Results are raw kernel results (-errno on failure).
+ * With -R, each submission is recorded with the SQEs it passes on.
+ * close() (and __gc) drops prepared requests, cancels submitted ones
+ * and waits for them, at most URING_DRAIN_MS: the kernel may still
+ * write into their buffers. A ring whose requests outlive that is
+ * leaked by __gc with their buffers, and close() raises.
+ */
+
+#define URING_MT "lktk.uring"
+
+#ifndef IORING_ASYNC_CANCEL_ANY
+#define IORING_ASYNC_CANCEL_ANY (1U << 2)
+#endif
+
+/* user_data of the drain's cancel request; tags start at 1 */
+#define URING_CANCEL_TAG 0
+/* how long close() waits for cancelled requests, ms */
+#define URING_DRAIN_MS 2000
+
+struct TLktkUring {
+    int fd;
+    unsigned flags;
+    unsigned features;
+    /* submission ring */
+    void *sq_ptr;
+    size_t sq_len;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_entries;
+    unsigned *sq_flags;
+    unsigned *sq_array;
+    unsigned sqe_tail;      /* prepared, not yet published */
+    unsigned sqe_published;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    /* completion ring */
+    void *cq_ptr;
+    size_t cq_len;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    unsigned cq_entries;
+    struct io_uring_cqe *cqes;
+    /* bookkeeping */
+    unsigned inflight;
+    __u64 next_tag;
+};
+typedef struct TLktkUring LktkUring;
+
+static long uring_setup(unsigned entries, struct io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static long uring_enter(int fd, unsigned to_submit,
+        unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit,
+            min_complete, flags, NULL, 0);
+}
+
+/* -R: the to_submit SQEs after the published ones, before publishing */
+static LktkRecCall *uring_record(LktkUring *r, unsigned to_submit,
+        unsigned min_complete, unsigned flags) {
+    long argz[LKTK_MAX_ARGS] = {r->fd, (long)to_submit, (long)min_complete,
+        (long)flags};
+    struct iovec sqes[2];
+    unsigned first = r->sqe_published & *r->sq_mask;
+    unsigned n = *r->sq_entries - first;
+    if (n > to_submit) {
+        n = to_submit;
+    }
+    /* the ring wraps at most once */
+    sqes[0].iov_base = &r->sqes[first];
+    sqes[0].iov_len = n * sizeof(struct io_uring_sqe);
+    sqes[1].iov_base = r->sqes;
+    sqes[1].iov_len = (to_submit - n) * sizeof(struct io_uring_sqe);
+    return rec_submit(argz, sqes, 2);
+}
+
+static void uring_unmap(LktkUring *r) {
+    if (r->sqes && r->sqes != MAP_FAILED) {
+        munmap(r->sqes, r->sqes_len);
+    }
+    if (r->cq_ptr && r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) {
+        munmap(r->cq_ptr, r->cq_len);
+    }
+    if (r->sq_ptr && r->sq_ptr != MAP_FAILED) {
+        munmap(r->sq_ptr, r->sq_len);
+    }
+    r->sqes = NULL;
+    r->cq_ptr = NULL;
+    r->sq_ptr = NULL;
+}
+
+static int uring_map(LktkUring *r, struct io_uring_params *p) {
+    r->sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    r->cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_len > r->sq_len) {
+            r->sq_len = r->cq_len;
+        }
+        r->cq_len = r->sq_len;
+    }
+    r->sq_ptr = mmap(0, r->sq_len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == r->sq_ptr) {
+        return -1;
+    }
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(0, r->cq_len, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == r->cq_ptr) {
+            return -1;
+        }
+    }
+    r->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(0, r->sqes_len, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (MAP_FAILED == r->sqes) {
+        return -1;
+    }
+    char *sq = (char *)r->sq_ptr;
+    r->sq_head = (unsigned *)(sq + p->sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p->sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p->sq_off.ring_mask);
+    r->sq_entries = (unsigned *)(sq + p->sq_off.ring_entries);
+    r->sq_flags = (unsigned *)(sq + p->sq_off.flags);
+    r->sq_array = (unsigned *)(sq + p->sq_off.array);
+    r->sqe_tail = r->sqe_published = *r->sq_tail;
+    char *cq = (char *)r->cq_ptr;
+    r->cq_head = (unsigned *)(cq + p->cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p->cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p->cq_off.ring_mask);
+    r->cq_entries = p->cq_entries;
+    r->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+static LktkUring *check_uring(lua_State *L) {
+    LktkUring *r = (LktkUring *)luaL_checkudata(L, 1, URING_MT);
+    if (r->fd < 0) {
+        luaL_error(L, "uring: ring is closed");
+    }
+    return r;
+}
+
+// uring(depth [, flags])
+static int uringNew(lua_State *L) {
+    struct io_uring_params p;
+    unsigned depth = (unsigned)luaL_checkinteger(L, 1);
+    memset(&p, 0, sizeof(p));
+    p.flags = (unsigned)luaL_optinteger(L, 2, 0);
+    LktkUring *r = (LktkUring *)lua_newuserdata(L, sizeof(LktkUring));
+    memset(r, 0, sizeof(LktkUring));
+    r->fd = -1;
+    luaL_setmetatable(L, URING_MT);
+    /* pending args: tag -> {args...} */
+    lua_newtable(L);
+    lua_setuservalue(L, -2);
+    if (p.flags & IORING_SETUP_SQPOLL) {
+        p.sq_thread_idle = 1000; /* ms */
+    }
+    r->fd = (int)uring_setup(depth, &p);
+    if (r->fd < 0) {
+        log_error("io_uring_setup failed: %s", strerror(errno));
+        lua_pushnil(L);
+        lua_pushinteger(L, errno);
+        return 2;
+    }
+    r->flags = p.flags;
+    r->features = p.features;
+    if (uring_map(r, &p)) {
+        int err = errno;
+        log_error("io_uring mmap failed: %s", strerror(err));
+        uring_unmap(r);
+        close(r->fd);
+        r->fd = -1;
+        lua_pushnil(L);
+        lua_pushinteger(L, err);
+        return 2;
+    }
+    log_info("io_uring %d: sq %u cq %u entries%s", r->fd,
+            p.sq_entries, p.cq_entries,
+            (r->flags & IORING_SETUP_SQPOLL) ? " (sqpoll)" : "");
+    return 1;
+}
+
+// ring:prep(op, fd, addr, len, off, op_flags) -> tag
+static int uringPrep(lua_State *L) {
+    LktkUring *r = check_uring(L);
+    LktkShape *shape = NULL;
+    int i, anchor = 0;
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sqe_tail - head >= *r->sq_entries) {
+        return luaL_error(L, "uring: submission queue full");
+    }
+    if (r->inflight >= r->cq_entries) {
+        return luaL_error(L, "uring: too many requests in flight");
+    }
+    unsigned idx = r->sqe_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (__u8)luaL_checkinteger(L, 2);
+    sqe->fd = (__s32)luaL_optinteger(L, 3, -1);
+    if (!lua_isnoneornil(L, 4)) {
+        sqe->addr = (__u64)any_to_long(L, 4, &shape);
+    }
+    sqe->len = (__u32)luaL_optinteger(L, 5, 0);
+    if (!lua_isnoneornil(L, 6)) {
+        sqe->off = (__u64)any_to_long(L, 6, &shape);
+    }
+    sqe->rw_flags = (__kernel_rwf_t)luaL_optinteger(L, 7, 0);
+    sqe->user_data = ++r->next_tag;
+    /* keep non-scalar args alive (and known) until reaped */
+    for (i = 4; i <= 6; i += 2) {
+        int t = lua_type(L, i);
+        if (LUA_TSTRING == t || LUA_TTABLE == t || LUA_TUSERDATA == t) {
+            anchor = 1;
+        }
+    }
+    if (anchor) {
+        lua_getuservalue(L, 1);
+        lua_createtable(L, 2, 0);
+        lua_pushvalue(L, 4);
+        lua_rawseti(L, -2, 1);
+        lua_pushvalue(L, 6);
+        lua_rawseti(L, -2, 2);
+        lua_rawseti(L, -2, (lua_Integer)sqe->user_data);
+        lua_pop(L, 1);
+    }
+    r->sq_array[idx] = idx;
+    r->sqe_tail++;
+    r->inflight++;
+    lua_pushinteger(L, (lua_Integer)sqe->user_data);
+    return 1;
+}
+
+// ring:submit([wait_nr]) -> submitted
+static int uringSubmit(lua_State *L) {
+    LktkUring *r = check_uring(L);
+    unsigned wait_nr = (unsigned)luaL_optinteger(L, 2, 0);
+    unsigned to_submit = r->sqe_tail - r->sqe_published;
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    LktkRecCall *rc = NULL;
+    long ret;
+    if ((r->flags & IORING_SETUP_SQPOLL)
+            && (__atomic_load_n(r->sq_flags, __ATOMIC_ACQUIRE)
+                & IORING_SQ_NEED_WAKEUP)) {
+        flags |= IORING_ENTER_SQ_WAKEUP;
+    }
+    if (to_submit) {
+        rc = uring_record(r, to_submit, wait_nr, flags);
+    }
+    __atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+    r->sqe_published = r->sqe_tail;
+    if ((r->flags & IORING_SETUP_SQPOLL)
+            && !(flags & IORING_ENTER_SQ_WAKEUP) && !wait_nr) {
+        /* kernel thread picks entries up by itself */
+        rec_result(rc, to_submit, 0);
+        lua_pushinteger(L, to_submit);
+        return 1;
+    }
+    ret = uring_enter(r->fd, to_submit, wait_nr, flags);
+    rec_result(rc, ret, ret < 0 ? errno : 0);
+    if (ret < 0) {
+        lua_pushinteger(L, -1);
+        lua_pushinteger(L, errno);
+        return 2;
+    }
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
+static void uring_release(lua_State *L, __u64 tag) {
+    int i;
+    lua_getuservalue(L, 1);
+    if (LUA_TTABLE == lua_rawgeti(L, -1, (lua_Integer)tag)) {
+        for (i = 1; i <= 2; i++) {
+            if (LUA_TTABLE == lua_rawgeti(L, -1, i)) {
+                LktkShape *shape = get_shape(L, lua_absindex(L, -1));
+                if (shape) {
+                    marshall(L, lua_absindex(L, -1), shape);
+                }
+            }
+            lua_pop(L, 1);
+        }
+        lua_pushnil(L);
+        lua_rawseti(L, -3, (lua_Integer)tag);
+    }
+    lua_pop(L, 2);
+}
+
+// ring:reap([min_complete]) -> tags, results
+static int uringReap(lua_State *L) {
+    LktkUring *r = check_uring(L);
+    unsigned min_complete = (unsigned)luaL_optinteger(L, 2, 0);
+    unsigned head, tail;
+    int n = 0;
+    head = *r->cq_head;
+    tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    if (tail - head < min_complete) {
+        if (uring_enter(r->fd, 0, min_complete,
+                IORING_ENTER_GETEVENTS) < 0 && EINTR != errno) {
+            return luaL_error(L, "uring: io_uring_enter: %s",
+                    strerror(errno));
+        }
+        tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    lua_createtable(L, tail - head, 0);
+    lua_createtable(L, tail - head, 0);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        __u64 tag = cqe->user_data;
+        n++;
+        lua_pushinteger(L, (lua_Integer)tag);
+        lua_rawseti(L, -3, n);
+        lua_pushinteger(L, cqe->res);
+        lua_rawseti(L, -2, n);
+        head++;
+        if (URING_CANCEL_TAG == tag) {
+            n--; /* left over from a failed close() */
+            continue;
+        }
+        uring_release(L, tag);
+        r->inflight--;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return 2;
+}
+
+static unsigned uring_wakeup(LktkUring *r) {
+    if ((r->flags & IORING_SETUP_SQPOLL)
+            && (__atomic_load_n(r->sq_flags, __ATOMIC_ACQUIRE)
+                & IORING_SQ_NEED_WAKEUP)) {
+        return IORING_ENTER_SQ_WAKEUP;
+    }
+    return 0;
+}
+
+/* asks the kernel to cancel everything in flight */
+static void uring_cancel(LktkUring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned flags = uring_wakeup(r);
+    unsigned idx = r->sqe_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    LktkRecCall *rc;
+    long ret;
+    if (r->sqe_tail - head >= *r->sq_entries) {
+        return; /* no room: only wait */
+    }
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = URING_CANCEL_TAG;
+    r->sq_array[idx] = idx;
+    r->sqe_tail++;
+    rc = uring_record(r, 1, 0, flags);
+    __atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+    r->sqe_published = r->sqe_tail;
+    ret = uring_enter(r->fd, 1, 0, flags);
+    rec_result(rc, ret, ret < 0 ? errno : 0);
+}
+
+/* drops completions; the cancel request's own is not in flight */
+static void uring_drop_cqes(LktkUring *r) {
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        if (URING_CANCEL_TAG != r->cqes[head & *r->cq_mask].user_data
+                && r->inflight) {
+            r->inflight--;
+        }
+    }
+    __atomic_store_n(r->cq_head, tail, __ATOMIC_RELEASE);
+}
+
+/* waits up to ms for min_complete completions */
+static long uring_wait(LktkUring *r, unsigned min_complete, long ms) {
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    if (!(r->features & IORING_FEAT_EXT_ARG)) {
+        usleep(10 * 1000); /* no timed wait before 5.11: poll */
+        return 0;
+    }
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (__u64)(uintptr_t)&ts;
+    return syscall(__NR_io_uring_enter, r->fd, 0, min_complete,
+            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+/*
+ ** Drops what is only prepared (the kernel never saw it), cancels what
+ ** is submitted and waits for it, at most URING_DRAIN_MS.
+ ** Returns -1 with errno (ETIME if requests outlive the wait) on failure.
+ */
+static int uring_drain(LktkUring *r) {
+    unsigned unpublished = r->sqe_tail - r->sqe_published;
+    struct timespec start, now;
+    long left;
+    r->sqe_tail = r->sqe_published;
+    r->inflight -= (unpublished < r->inflight) ? unpublished : r->inflight;
+    uring_drop_cqes(r); /* completed, not reaped */
+    if (!r->inflight) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uring_cancel(r);
+    for (;;) {
+        uring_drop_cqes(r);
+        if (!r->inflight) {
+            return 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left = URING_DRAIN_MS - (now.tv_sec - start.tv_sec) * 1000
+            - (now.tv_nsec - start.tv_nsec) / 1000000;
+        if (left <= 0) {
+            errno = ETIME;
+            return -1;
+        }
+        if (uring_wait(r, r->inflight, left) < 0
+                && EINTR != errno && ETIME != errno) {
+            return -1;
+        }
+    }
+}
+
+static void uring_free(LktkUring *r) {
+    uring_unmap(r);
+    close(r->fd);
+    r->fd = -1;
+}
+
+static int uringClose(lua_State *L) {
+    LktkUring *r = (LktkUring *)luaL_checkudata(L, 1, URING_MT);
+    if (r->fd >= 0) {
+        if (uring_drain(r)) {
+            return luaL_error(L, "uring: cannot wait for %d requests: %s",
+                    (int)r->inflight, strerror(errno));
+        }
+        /* nothing in flight: drop the anchored arguments */
+        lua_newtable(L);
+        lua_setuservalue(L, 1);
+        uring_free(r);
+    }
+    return 0;
+}
+
+static int uringGc(lua_State *L) {
+    LktkUring *r = (LktkUring *)luaL_checkudata(L, 1, URING_MT);
+    if (r->fd >= 0) {
+        if (uring_drain(r)) {
+            /* the kernel may still write into the buffers: keep all */
+            log_error("uring %d: %d requests outlive the ring, leaked",
+                    r->fd, (int)r->inflight);
+            lua_getuservalue(L, 1);
+            luaL_ref(L, LUA_REGISTRYINDEX);
+            return 0;
+        }
+        uring_free(r);
+    }
+    return 0;
+}
+
+static int uringPending(lua_State *L) {
+    LktkUring *r = check_uring(L);
+    lua_pushinteger(L, r->inflight);
+    return 1;
+}
+
+static const struct luaL_Reg uring_methods[] = {
+    {"prep", uringPrep},
+    {"submit", uringSubmit},
+    {"reap", uringReap},
+    {"pending", uringPending},
+    {"close", uringClose},
+    {"__gc", uringGc},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg lktkuring_globals[] = {
+    {"uring", uringNew},
+    {NULL, NULL}
+};
+
+#define URING_CONST(_n, _v) do{\
+    lua_pushinteger(L, _v);\
+    lua_setfield(L, -2, #_n);}while(0)
+
+void inject_lktkuring(lua_State* L) {
+    luaL_newmetatable(L, URING_MT);
+    luaL_setfuncs(L, uring_methods, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    lua_pushglobaltable(L);
+    luaL_setfuncs(L, lktkuring_globals, 0);
+    URING_CONST( URING_SQPOLL, IORING_SETUP_SQPOLL );
+    URING_CONST( URING_NOP,    IORING_OP_NOP       );
+    URING_CONST( URING_READV,  IORING_OP_READV     );
+    URING_CONST( URING_WRITEV, IORING_OP_WRITEV    );
+    URING_CONST( URING_FSYNC,  IORING_OP_FSYNC     );
+    URING_CONST( URING_OPENAT, IORING_OP_OPENAT    );
+    URING_CONST( URING_CLOSE,  IORING_OP_CLOSE     );
+    URING_CONST( URING_STATX,  IORING_OP_STATX     );
+    URING_CONST( URING_READ,   IORING_OP_READ      );
+    URING_CONST( URING_WRITE,  IORING_OP_WRITE     );
+    lua_pop(L, 1);
+}
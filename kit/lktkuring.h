@@ -0,0 +1,8 @@
+#ifndef LKTKURING_H
+#define LKTKURING_H
+
+#include "lktklib.h"
+
+void inject_lktkuring(lua_State* L);
+
+#endif
@@ -11,6 +11,7 @@
 
 
 #include <string.h>
+#include <time.h>
 
 #include "lua.h"
 
@@ -26,6 +27,20 @@
 #include "ltm.h"
 
 
+/*
+** clock of the GC time counter ('gcclock' in global_State), in ns
+*/
+static lu_mem gcclock (void) {
+#if defined(LUA_USE_POSIX)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return cast(lu_mem, ts.tv_sec) * 1000000000u + cast(lu_mem, ts.tv_nsec);
+#else
+  return cast(lu_mem, clock()) * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+
 /*
 ** internal state for collector while inside the atomic phase. The
 ** collector should never be in this state while running regular code.
@@ -1128,10 +1143,12 @@ static l_mem getdebt (global_State *g) {
 void luaC_step (lua_State *L) {
   global_State *g = G(L);
   l_mem debt = getdebt(g);  /* GC deficit (be paid now) */
+  lu_mem t0;
   if (!g->gcrunning) {  /* not running? */
     luaE_setdebt(g, -GCSTEPSIZE * 10);  /* avoid being called too often */
     return;
   }
+  t0 = gcclock();
   do {  /* repeat until pause or enough "credit" (negative debt) */
     lu_mem work = singlestep(L);  /* perform one single step */
     debt -= work;
@@ -1143,6 +1160,8 @@ void luaC_step (lua_State *L) {
     luaE_setdebt(g, debt);
     runafewfinalizers(L);
   }
+  g->gcsteps++;
+  g->gcclock += gcclock() - t0;
 }
 
 
@@ -1157,6 +1176,7 @@ void luaC_step (lua_State *L) {
 */
 void luaC_fullgc (lua_State *L, int isemergency) {
   global_State *g = G(L);
+  lu_mem t0 = gcclock();
   lua_assert(g->gckind == KGC_NORMAL);
   if (isemergency) g->gckind = KGC_EMERGENCY;  /* set flag */
   if (keepinvariant(g)) {  /* black objects? */
@@ -1171,6 +1191,8 @@ void luaC_fullgc (lua_State *L, int isemergency) {
   luaC_runtilstate(L, bitmask(GCSpause));  /* finish collection */
   g->gckind = KGC_NORMAL;
   setpause(g);
+  g->gcfull++;
+  g->gcclock += gcclock() - t0;
 }
 
 /* }====================================================== */
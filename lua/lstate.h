@@ -136,6 +136,9 @@ struct Tglobal_State {
 	unsigned int gcfinnum; /* number of finalizers to call in each GC step */
 	int gcpause; /* size of pause between successive GCs */
 	int gcstepmul; /* GC 'granularity' */
+	lu_mem gcclock; /* ns spent collecting (steps and full cycles) */
+	lu_mem gcsteps; /* incremental steps taken */
+	lu_mem gcfull; /* full cycles */
 	lua_CFunction panic; /* to be called in unprotected errors */
 	struct lua_State *mainthread;
 	const lua_Number *version; /* pointer to version number */
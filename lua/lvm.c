@@ -767,6 +767,19 @@ void luaV_finishOp (lua_State *L) {
 #define vmbreak		break
 
 
+/*
+** threaded dispatch (computed goto), where the compiler has it:
+** build with -DLUA_USE_JUMPTABLE=1, see ljumptab.h
+*/
+#if !defined(LUA_USE_JUMPTABLE)
+#define LUA_USE_JUMPTABLE	0
+#endif
+
+#if LUA_USE_JUMPTABLE && !defined(__GNUC__)
+#error "LUA_USE_JUMPTABLE needs GCC labels as values"
+#endif
+
+
 /*
 ** copy of 'luaV_gettable', but protecting the call to potential
 ** metamethod (which can reallocate the stack)
@@ -788,6 +801,9 @@ void luaV_execute (lua_State *L) {
   LClosure *cl;
   TValue *k;
   StkId base;
+#if LUA_USE_JUMPTABLE
+#include "ljumptab.h"
+#endif
   ci->callstatus |= CIST_FRESH;  /* fresh invocation of 'luaV_execute" */
  newframe:  /* reentry point when frame changes (call/return) */
   lua_assert(ci == L->ci);
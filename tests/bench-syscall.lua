@@ -0,0 +1,51 @@
+-- throughput of the syscall path and of the interpreter itself
+-- run with 'make bench' (debug build) and after 'make release'
+local sys = require "syscalls"
+
+local N = 200000
+
+local function bench(name, f)
+    local t = os.clock()
+    f()
+    local dt = os.clock() - t
+    print(string.format("%-20s %12.0f ops/s", name, N / dt))
+end
+
+bench("syscall(getpid)", function()
+    for i = 1,N do syscall(sys.getpid) end
+end)
+
+local st = {__type = stat}
+bench("syscall(stat, {})", function()
+    for i = 1,N do syscall(sys.stat, "/", st) end
+end)
+
+local sto = struct(stat)
+bench("syscall(stat, obj)", function()
+    for i = 1,N do syscall(sys.stat, "/", sto) end
+end)
+
+local sa = {__type = sched_attr}
+local size = sizeof_sched_attr()
+bench("sched_getattr, {}", function()
+    for i = 1,N do syscall(sys.sched_getattr, 0, sa, size, 0) end
+end)
+
+local sao = struct(sched_attr)
+bench("sched_getattr, obj", function()
+    for i = 1,N do syscall(sys.sched_getattr, 0, sao, size, 0) end
+end)
+
+bench("table churn", function()
+    for i = 1,N do
+        local t = {__type = flock, l_type = F_WRLCK, l_start = i}
+        t.l_len = t.l_start + 1
+    end
+end)
+
+bench("string ops", function()
+    for i = 1,N do
+        local s = string.format("fcntl%d", i % 64)
+        s = s .. "." .. #s
+    end
+end)
@@ -0,0 +1,83 @@
+-- opcode throughput of the Lua VM on what our scripts spend time on
+-- 'make bench-vm' runs it on the switch and the threaded (goto) VM
+local sys = require "syscalls"
+local m = require "mutator"
+
+local N = 500000
+
+-- VM instructions one run of f executes, from a count hook
+local function instructions(f)
+    local n = 0
+    debug.sethook(function() n = n + 1 end, "", 100)
+    f()
+    debug.sethook()
+    return n * 100
+end
+
+local function bench(name, f)
+    local ops = instructions(f)
+    local best = math.huge
+    for r = 1, 5 do
+        local t = os.clock()
+        f()
+        best = math.min(best, os.clock() - t)
+    end
+    print(string.format("%-16s %8.1f Minstr %8.1f Minstr/s", name,
+        ops / 1e6, ops / best / 1e6))
+end
+
+-- the fuzzing loop: arguments for every syscall with a prototype
+local nrs = {}
+for name, nr in pairs(sys) do
+    if math.type(nr) == "integer" and syscall_info(nr) then
+        nrs[#nrs + 1] = nr
+    end
+end
+table.sort(nrs)
+for _, nr in ipairs(nrs) do m.prototype(nr) end
+bench("mutator args", function()
+    for i = 1, N // #nrs do
+        for _, nr in ipairs(nrs) do m.args(nr) end
+    end
+end)
+
+bench("table churn", function()
+    for i = 1, N do
+        local t = {__type = flock, l_type = F_WRLCK, l_start = i}
+        t.l_len = t.l_start + 1
+    end
+end)
+
+bench("string ops", function()
+    for i = 1, N do
+        local s = string.format("fcntl%d", i % 64)
+        s = s .. "." .. #s
+    end
+end)
+
+bench("bit masks", function()
+    local v = 0
+    for i = 1, N do
+        local mask = i ~ (i >> 1)
+        while mask ~= 0 do
+            v = v | (mask & -mask)
+            mask = mask & (mask - 1)
+        end
+    end
+end)
+
+local Obj = {}
+Obj.__index = Obj
+function Obj:step(x) self.n = self.n + x return self end
+bench("method calls", function()
+    local o = setmetatable({n = 0}, Obj)
+    for i = 1, N do o:step(1):step(i & 3) end
+end)
+
+bench("closures", function()
+    local function adder(a) return function(...) return a + select("#", ...) end end
+    local s = 0
+    for i = 1, N do s = s + adder(i)(i, i) end
+end)
+
+m.cleanup()
@@ -16,6 +16,15 @@ assert_ge(syscall(sys.getuid), 0)
 assert_ge(syscall(sys.geteuid), 0)
 assert_eq(syscall(1984), -1, "wrong syscall should fail")
 
+-- errno comes back with the result
+local res, err = syscall(1984)
+assert_eq(err, ENOSYS, "ENOSYS for wrong syscall")
+assert_true(errno_name[err] == "ENOSYS", "errno name")
+res, err = syscall(sys.close, -1)
+assert_eq(err, EBADF, "EBADF for closing -1")
+res, err = syscall(sys.getpid)
+assert_eq(err, 0, "no errno on success")
+
 print("--- sched_attr tests ---")
 
 local sa = {
@@ -0,0 +1,21 @@
+local sys = require "syscalls"
+
+local pid = syscall(sys.getpid)
+local res, err = syscall_batch({
+    {sys.getpid},
+    {sys.getppid},
+    {1984},
+    {sys.close, -1},
+})
+assert_eq(res[1], pid, "batched getpid")
+assert_gt(res[2], 0, "batched getppid")
+assert_eq(res[3], -1, "wrong syscall should fail")
+assert_eq(err[3], 38, "ENOSYS for wrong syscall")
+assert_eq(err[4], 9, "EBADF for closing -1")
+assert_eq(err[1], 0, "no errno on success")
+
+-- same vector hammered many times, struct args marshalled back
+local st = {__type = stat}
+res, err = syscall_batch({{sys.stat, "/", st}, {sys.getpid}}, 1000)
+assert_eq(res[1], 0, "batched stat")
+assert_eq(st.st_mode & S_IFMT, S_IFDIR, "'/' is a directory")
@@ -0,0 +1,59 @@
+-- ten single bit flags: 1024 distinct values in Gray code order
+local bits = {}
+for i = 0, 9 do bits[#bits + 1] = 1 << (i * 3) end
+local fs = flagset(bits)
+assert_eq(#fs, 10, "flag count")
+
+local seen, n, prev, steps_ok = {}, 0, nil, true
+for v, mask in fs:subsets() do
+    if prev then
+        local diff = prev ~ v
+        steps_ok = steps_ok and diff ~= 0 and (diff & (diff - 1)) == 0
+    end
+    assert_true(v == fs:value(mask), "value follows mask")
+    seen[v] = true
+    prev = v
+    n = n + 1
+end
+local distinct = 0
+for _ in pairs(seen) do distinct = distinct + 1 end
+assert_eq(n, 1024, "all subsets enumerated")
+assert_eq(distinct, 1024, "no subset twice")
+assert_true(steps_ok, "one flag changes per step")
+assert_eq(fs:subset(0), 0, "enumeration starts empty")
+assert_eq(fs:subset(3), bits[2], "gray code subset by index")
+
+-- overlapping flags are combined with OR, not XOR
+local ov = flagset{3, 1, 2}
+local all = 0
+for v in ov:subsets() do all = all | v end
+assert_eq(all, 3, "overlapping union")
+assert_eq(ov:value(7), 3, "overlapping value")
+
+-- random subsets stay inside the union, for any size
+local wide = {}
+for i = 0, 63 do wide[#wide + 1] = 1 << i end
+local w = flagset(wide)
+local union, ors = 0, 0
+for i = 1, 1000 do
+    union = union | w:random()
+end
+assert_eq(union, -1, "64 flags all reachable")
+local r = flagset(bits)
+for i = 1, 1000 do ors = ors | r:random() end
+assert_true(ors & ~0x9249249 == 0, "random within union")
+
+-- weights: always, never, sometimes
+local ws = flagset({1, 2, 4}, {1, 0, 0.5})
+local got4 = 0
+for i = 1, 1000 do
+    local v = ws:random()
+    assert_true(v & 1 == 1 and v & 2 == 0,
+        "weight 1 always and weight 0 never")
+    got4 = got4 + (v & 4) // 4
+end
+assert_true(got4 > 300 and got4 < 700, "weight 0.5 about half: " .. got4)
+
+assert_true(not pcall(flagset, wide, {1}), "one weight per flag")
+wide[65] = 1
+assert_true(not pcall(flagset, wide), "at most 64 flags")
@@ -0,0 +1,37 @@
+local sys = require "syscalls"
+require "utils"
+
+-- -F: every job starts from the state as it was after initialization
+local script = "fresh." .. syscall(sys.getpid) .. ".lua"
+local out = io.open(script, "w")
+out:write([[
+package.loaded.fresh = (package.loaded.fresh or 0) + 1
+print(package.loaded.fresh, math.random(1 << 30))
+assert_true(package.loaded.fresh == 1, "fresh state")
+]])
+out:close()
+local function run(opts)
+    return shell("./lktk -q " .. opts .. " " .. script)
+end
+
+local kept = run("-S 3 -c 3")
+assert_true(kept:find("\n3\t"), "without -F the state carries over")
+local fresh = run("-F -S 3 -c 3")
+local n = 0
+for c in fresh:gmatch("(%d+)\t%d+\n") do
+    assert_eq(c, "1", "every job runs on a fresh state")
+    n = n + 1
+end
+assert_eq(n, 3, "all iterations ran")
+assert_true(not fresh:find("Failed"), "no state left from previous jobs")
+assert_eq(fresh:match("^1\t(%d+)"), kept:match("^1\t(%d+)"),
+    "same random stream as without -F")
+assert_eq(#run("-F -p 2 -c 4"):gsub("[^\n]", ""), 4, "pool")
+
+-- a job that dies leaves the runner going
+out = io.open(script, "w")
+out:write('local sys = require "syscalls"\nsyscall(sys.kill, syscall(sys.getpid), 9)\n')
+out:close()
+assert_true(run("-F -c 2"):find("killed by signal 9.*killed by signal 9"),
+    "dead jobs reported")
+syscall(sys.unlink, script)
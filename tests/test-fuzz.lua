@@ -0,0 +1,40 @@
+local sys = require "syscalls"
+
+local pid = syscall(sys.getpid)
+local filename = "fuzz." .. pid
+local fd = syscall(sys.open, filename,
+    O_CREAT | O_RDWR | O_NONBLOCK, S_IRUSR | S_IWUSR)
+assert_gt(fd, 0, "scratch file created")
+
+local calls = {sys.read, sys.write, sys.pread64, sys.pwrite64, sys.lseek,
+    sys.fstat, sys.stat, sys.access, sys.fcntl, sys.dup, sys.getdents64,
+    sys.ftruncate, sys.uname, sys.getcwd, sys.getpid}
+local f = fuzzer{calls = calls, fds = {fd, -1}, paths = {filename, ""},
+    seed = 42}
+
+local added = f:run(2000)
+local st = f:stats()
+assert_gt(st.execs, 1999, "every program issued its calls")
+assert_eq(st.corpus, added, "new edges keep the program")
+assert_gt(st.corpus, 0, "corpus grows")
+assert_gt(st.edges, 0, "edges seen")
+print("fuzzer: " .. st.execs .. " calls, " .. st.edges .. " edges, "
+    .. st.corpus .. " programs, kcov " .. tostring(st.kcov))
+
+local prog = f:program(1)
+local known = {}
+for _, nr in ipairs(calls) do known[nr] = true end
+assert_true(known[prog[1][1]], "programs use the given calls")
+
+local later = syscall(sys.open, filename, O_RDONLY)
+assert_gt(later, fd, "fd opened after the fuzzer")
+f:run(100)
+assert_gt(f:stats().execs, st.execs, "runs continue from the corpus")
+assert_gt(syscall(sys.fcntl, later, F_GETFD), -1, "fds open before f:run() survive")
+assert_gt(syscall(sys.fcntl, fd, F_GETFD), -1, "fuzzer fds survive")
+syscall(sys.close, later)
+f:close()
+assert_true(not pcall(f.run, f, 1), "closed fuzzer refuses to run")
+
+syscall(sys.close, fd)
+syscall(sys.unlink, filename)
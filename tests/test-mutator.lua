@@ -54,3 +54,35 @@ print(string.format("%d - %d", i.min, i.max))
 local ii = m.TypeInteger:new()
 print(string.format("%d - %d", ii.min, ii.max))
 
+
+local sys = require "syscalls"
+
+-- every native syscall gets a full prototype
+local short = {}
+for name, nr in pairs(sys) do
+    if #m.prototype(nr) ~= syscall_info(nr).nargs then
+        short[#short + 1] = name
+    end
+end
+assert_eq(#short, 0, "prototypes for all syscalls " .. table.concat(short, " "))
+
+-- overloaded syscall reaches the kernel
+assert_eq(syscall(sys.getpid), m.syscall(sys.getpid), "getpid forwarded")
+local res, err = syscall(sys.exit_group)
+assert_eq(err, EPERM, "exit_group is never forwarded")
+
+local args = m.args(sys.read)
+assert_eq(args.n, 3, "read gets three arguments")
+assert_true("userdata" == type(args[2]) and args[3] <= #args[2],
+    "read length fits its buffer")
+
+-- a few rounds over the whole table, the interpreter must survive
+local calls = 0
+for round = 1, 3 do
+    for name, nr in pairs(sys) do
+        syscall(nr)
+        calls = calls + 1
+    end
+end
+assert_gt(calls, 0, "fuzzed " .. calls .. " calls")
+m.cleanup()
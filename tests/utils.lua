@@ -33,3 +33,11 @@ function table.tostring(tbl)
   end
   return "{" .. table.concat( result, "," ) .. "}"
 end
+
+-- output of a shell command, stderr included
+function shell(cmd)
+  local p = io.popen(cmd .. " 2>&1")
+  local s = p:read("a")
+  p:close()
+  return s
+end